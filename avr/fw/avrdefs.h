@@ -139,6 +139,9 @@ typedef const CHAR*           PCSTR;
 #ifndef IgnoreParam
 #  define IgnoreParam(p)      (void)(p)
 #endif
+#ifndef MemoryBarrier
+#  define MemoryBarrier()     __asm__ __volatile__ ("" ::: "memory")
+#endif
 //===========================================================================
 // AVR PINS
 //===========================================================================
@@ -0,0 +1,165 @@
+//===========================================================================
+// Module:  bus.h
+// Purpose: Asynchronous bus transaction framework
+//
+// Copyright © 2013
+// Brent M. Spell. All rights reserved.
+//
+// This library is free software; you can redistribute it and/or modify it 
+// under the terms of the GNU Lesser General Public License as published 
+// by the Free Software Foundation; either version 3 of the License, or 
+// (at your option) any later version. This library is distributed in the 
+// hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+// See the GNU Lesser General Public License for more details. You should 
+// have received a copy of the GNU Lesser General Public License along with 
+// this library; if not, write to 
+//    Free Software Foundation, Inc. 
+//    51 Franklin Street, Fifth Floor 
+//    Boston, MA 02110-1301 USA
+//===========================================================================
+#ifndef __BUS_H
+#define __BUS_H
+//-------------------[       Pre Include Defines       ]-------------------//
+//-------------------[      Library Include Files      ]-------------------//
+//-------------------[      Project Include Files      ]-------------------//
+#ifndef __AVRDEFS_H
+#include "avrdefs.h"
+#endif
+//-------------------[       Module Definitions        ]-------------------//
+//===========================================================================
+// BUS TRANSACTIONS
+// . a transaction is a caller-owned descriptor for one addressed exchange
+//   with a slave device, which is queued on a bus driver (spimast,
+//   uspimast, i2cmast) and must remain valid until it completes
+// . each driver runs its queued transactions in order from its ISR; on
+//   completion, fBusy is cleared, nStatus holds the result, and the
+//   completion callback is called from the ISR, where it may queue the
+//   same or another transaction (on any bus), so that dependent I/O can
+//   be chained into a pipeline without involving the main loop
+// . nAddress selects the slave: the slave select pin for SPI (or
+//   PIN_INVALID for none), or the 7-bit slave address for I2C
+// . pvDevice points to bus-specific device settings (SPI_DEVICE for the
+//   SPI master), or NULL for the bus defaults
+// . the data exchanged depends on the bus:
+//   . SPI is full duplex: max(cbSend, cbRecv) bytes are exchanged, with
+//     zeros sent after the send buffer
+//   . I2C is half duplex: cbSend bytes are written, and then cbRecv bytes
+//     are read after a repeated START
+// . a transaction with cSegments != 0 instead takes its data from each of
+//   its segments in order, so that a command and its payload can come
+//   from (and go to) separate buffers without staging copies;
+//   pbSend/cbSend and pbRecv/cbRecv are then ignored
+//   . on SPI, each segment exchanges cbData bytes
+//   . on I2C, the segments with a send buffer form the write phase and
+//     the segments with a receive buffer form the read phase
+//===========================================================================
+// transaction status codes
+#define BUS_STATUS_OK            0x00     // transaction completed
+#define BUS_STATUS_BUSY          0x01     // queued or in progress
+#define BUS_STATUS_ADDR_NACK     0x02     // slave did not ACK its address
+#define BUS_STATUS_DATA_NACK     0x03     // slave did not ACK a data byte
+#define BUS_STATUS_ARB_LOST      0x04     // arbitration lost on the bus
+#define BUS_STATUS_BUS_ERROR     0x05     // illegal START/STOP or bad state
+#define BUS_STATUS_TIMEOUT       0x06     // transaction deadline expired
+typedef struct tagBusSegment
+{
+   PCBYTE            pbSend;              // send buffer (or NULL)
+   PBYTE             pbRecv;              // receive buffer (or NULL)
+   BSIZE             cbData;              // number of bytes to exchange
+} BUS_SEGMENT, *PBUS_SEGMENT;
+typedef struct tagBusTransaction BUS_TRANSACTION, *PBUS_TRANSACTION;
+typedef VOID (*BUS_CALLBACK) (PBUS_TRANSACTION pTrans);
+struct tagBusTransaction
+{
+   PBUS_TRANSACTION  pNext;               // queue link, owned by the driver
+   volatile BOOL     fBusy;               // queued or in progress
+   volatile UI8      nStatus;             // completion status (BUS_STATUS_*)
+   UI8               nAddress;            // slave select pin/slave address
+   PCVOID            pvDevice;            // device settings (NULL for default)
+   PCBYTE            pbSend;              // send buffer
+   BSIZE             cbSend;              // number of bytes to send
+   PBYTE             pbRecv;              // receive buffer
+   BSIZE             cbRecv;              // number of bytes to receive
+   PBUS_SEGMENT      pSegments;           // segment list (optional)
+   UI8               cSegments;           // number of segments
+   BUS_CALLBACK      pfnOnComplete;       // completion callback (optional)
+   PVOID             pvContext;           // callback context
+};
+//===========================================================================
+// BUS INTERFACE
+// . a bus interface holds the queue/execute entry points of a bus driver,
+//   so that a device driver can be written once against the transaction
+//   model and run over any compatible bus (e.g. SPI or USART SPI)
+// . each driver provides an initializer for its interface (SPI_BUS,
+//   USPI_BUS, I2C_BUS)
+//===========================================================================
+typedef VOID (*BUS_QUEUE)   (PBUS_TRANSACTION pTrans);
+typedef UI8  (*BUS_EXECUTE) (PBUS_TRANSACTION pTrans);
+typedef struct tagBus
+{
+   BUS_QUEUE         pfnQueue;            // queues a transaction
+   BUS_EXECUTE       pfnExecute;          // executes a transaction
+} BUS, *PBUS;
+typedef const BUS* PCBUS;
+// transaction helpers
+inline BOOL BusTransIsBusy (PBUS_TRANSACTION pTrans)
+   { return pTrans->fBusy; }
+inline UI8 BusTransWait (PBUS_TRANSACTION pTrans)
+   { while (BusTransIsBusy(pTrans)); return pTrans->nStatus; }
+// bus interface helpers
+inline VOID BusQueue (PCBUS pBus, PBUS_TRANSACTION pTrans)
+   { pBus->pfnQueue(pTrans); }
+inline UI8 BusExecute (PCBUS pBus, PBUS_TRANSACTION pTrans)
+   { return pBus->pfnExecute(pTrans); }
+//-----------< FUNCTION: BusSendRecv >---------------------------------------
+// Purpose:    executes a simple send/receive transaction on a bus
+// Parameters: pBus     - the bus interface to execute on
+//             nAddress - device address (SS pin or I2C slave address)
+//             pvSend   - the buffer to send
+//             cbSend   - the number of bytes to send
+//             pvRecv   - the buffer to receive into
+//             cbRecv   - the number of bytes to receive
+// Returns:    the transaction status
+//---------------------------------------------------------------------------
+inline UI8 BusSendRecv (
+   PCBUS    pBus,
+   UI8      nAddress,
+   PCVOID   pvSend,
+   BSIZE    cbSend,
+   PVOID    pvRecv,
+   BSIZE    cbRecv)
+{
+   BUS_TRANSACTION trans =
+   {
+      .nAddress = nAddress,
+      .pbSend   = pvSend,
+      .cbSend   = cbSend,
+      .pbRecv   = pvRecv,
+      .cbRecv   = cbRecv
+   };
+   return BusExecute(pBus, &trans);
+}
+//-----------< FUNCTION: BusSendRecvV >--------------------------------------
+// Purpose:    executes a segmented (scatter/gather) transaction on a bus
+// Parameters: pBus      - the bus interface to execute on
+//             nAddress  - device address (SS pin or I2C slave address)
+//             pSegments - the transaction segments
+//             cSegments - the number of segments
+// Returns:    the transaction status
+//---------------------------------------------------------------------------
+inline UI8 BusSendRecvV (
+   PCBUS          pBus,
+   UI8            nAddress,
+   PBUS_SEGMENT   pSegments,
+   UI8            cSegments)
+{
+   BUS_TRANSACTION trans =
+   {
+      .nAddress  = nAddress,
+      .pSegments = pSegments,
+      .cSegments = cSegments
+   };
+   return BusExecute(pBus, &trans);
+}
+#endif // __BUS_H
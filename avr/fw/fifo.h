@@ -28,6 +28,47 @@
 //-------------------[      Project Include Files      ]-------------------//
 //-------------------[       Module Definitions        ]-------------------//
 //===========================================================================
+// FIFO CONFIGURATION
+// . FIFO_STATISTICS          enable high-water/overflow/underflow counters
+//                            for all FIFOs and rings (costs 5 bytes each)
+//===========================================================================
+#ifndef FIFO_STATISTICS
+#  define FIFO_STATISTICS     (0)
+#endif
+//===========================================================================
+// FIFO OVERFLOW POLICIES
+// . OVERWRITE:   a full FIFO discards its oldest byte to store the new one
+// . DROP:        a full FIFO discards the new byte, and the write succeeds
+// . REJECT:      a full FIFO refuses the new byte, and the write fails
+//===========================================================================
+#define FIFO_POLICY_OVERWRITE (0)
+#define FIFO_POLICY_DROP      (1)
+#define FIFO_POLICY_REJECT    (2)
+//===========================================================================
+// FIFO STATISTICS
+//===========================================================================
+typedef struct tagFifoStats
+{
+   UI8   cbHighWater;                     // maximum number of queued bytes
+   UI16  nOverflows;                      // writes that found the FIFO full
+   UI16  nUnderflows;                     // reads that found the FIFO empty
+} FIFO_STATS, *PFIFO_STATS;
+#if FIFO_STATISTICS
+#  define __FifoStats         FIFO_STATS Stats;
+#  define __FifoHighWater(p, cb)                                           \
+      do {                                                                 \
+         if ((cb) > (p)->Stats.cbHighWater)                                \
+            (p)->Stats.cbHighWater = (cb);                                 \
+      } while (0)
+#  define __FifoOverflow(p)   (p)->Stats.nOverflows++
+#  define __FifoUnderflow(p)  (p)->Stats.nUnderflows++
+#else
+#  define __FifoStats
+#  define __FifoHighWater(p, cb)  do { } while (0)
+#  define __FifoOverflow(p)       do { } while (0)
+#  define __FifoUnderflow(p)      do { } while (0)
+#endif
+//===========================================================================
 // FIFO STRUCTURES
 //===========================================================================
 // FIFO data structure
@@ -36,18 +77,23 @@ typedef struct tagFifo
    UI8   cbBuffer;
    UI8   cbOffset;
    UI8   cbLength;
+   UI8   fPolicy;
+   __FifoStats
    BYTE  pbBuffer[1];
 } FIFO;
 typedef volatile FIFO* PFIFO;
 // FIFO declaration
 #define DECLARE_FIFO(name, size)                                           \
+   DECLARE_FIFO_POLICY(name, size, FIFO_POLICY_OVERWRITE)
+#define DECLARE_FIFO_POLICY(name, size, policy)                            \
    static volatile union                                                   \
    {                                                                       \
       FIFO Fifo;                                                           \
       BYTE pbBuffer[sizeof(FIFO) + size - 1];                              \
    } __FifoBuffer_##name =                                                 \
-      { { .cbBuffer = size, .cbOffset = 0, .cbLength = 0 } };              \
-   static PFIFO name = &__FifoBuffer_##name.Fifo
+      { { .cbBuffer = size, .cbOffset = 0, .cbLength = 0,                  \
+          .fPolicy = policy } };                                           \
+   static PFIFO name __attribute__((unused)) = &__FifoBuffer_##name.Fifo
 //===========================================================================
 // FIFO API
 //===========================================================================
@@ -68,29 +114,309 @@ inline BYTE FifoRead (PFIFO pFifo)
          pFifo->cbOffset = (pFifo->cbOffset + 1) % pFifo->cbBuffer;
          pFifo->cbLength--;
       }
+      else
+         __FifoUnderflow(pFifo);
       return bData;
    }
-inline UI8 FifoReadBlock (PFIFO pFifo, PVOID pvData, UI8 cbData)
-   {
-      UI8 cb = 0;
-      while (cb < cbData && !FifoIsEmpty(pFifo))
-         ((PBYTE)pvData)[cb++] = FifoRead(pFifo);
-      return cb;
-   }
-inline VOID FifoWrite (PFIFO pFifo, BYTE bData)
+inline BOOL FifoWrite (PFIFO pFifo, BYTE bData)
    {
       UI8 cbOffset = (pFifo->cbOffset + pFifo->cbLength) % pFifo->cbBuffer;
       if (pFifo->cbLength < pFifo->cbBuffer)
+      {
          pFifo->cbLength++;
+         __FifoHighWater(pFifo, pFifo->cbLength);
+      }
       else
+      {
+         __FifoOverflow(pFifo);
+         if (pFifo->fPolicy != FIFO_POLICY_OVERWRITE)
+            return pFifo->fPolicy == FIFO_POLICY_DROP;
          pFifo->cbOffset = (pFifo->cbOffset + 1) % pFifo->cbBuffer;
+      }
       pFifo->pbBuffer[cbOffset] = bData;
-   }
-inline VOID FifoWriteBlock (PFIFO pFifo, PCVOID pvData, UI8 cbData)
-   {
-      for (UI8 i = 0; i < cbData; i++)
-         FifoWrite(pFifo, ((PBYTE)pvData)[i]);
+      return TRUE;
    }
 inline VOID FifoFlush (PFIFO pFifo)
    { pFifo->cbLength = 0; }
+// zero-copy span access
+// . PeekSpan returns the longest contiguous run of queued bytes,
+//   and CommitRead consumes bytes from the front of that run
+// . ReserveSpan returns the longest contiguous run of free space,
+//   and CommitWrite appends bytes written into that run
+inline PBYTE FifoPeekSpan (PFIFO pFifo, UI8* pcbSpan)
+   {
+      UI8 cbEnd = pFifo->cbBuffer - pFifo->cbOffset;
+      *pcbSpan = Min(pFifo->cbLength, cbEnd);
+      return (PBYTE)pFifo->pbBuffer + pFifo->cbOffset;
+   }
+inline VOID FifoCommitRead (PFIFO pFifo, UI8 cbRead)
+   {
+      UI8 cbOffset = pFifo->cbOffset + cbRead;
+      if (cbOffset >= pFifo->cbBuffer)
+         cbOffset -= pFifo->cbBuffer;
+      pFifo->cbOffset = cbOffset;
+      pFifo->cbLength -= cbRead;
+   }
+inline PBYTE FifoReserveSpan (PFIFO pFifo, UI8* pcbSpan)
+   {
+      UI8 cbOffset = pFifo->cbOffset + pFifo->cbLength;
+      if (cbOffset >= pFifo->cbBuffer)
+      {
+         cbOffset -= pFifo->cbBuffer;
+         *pcbSpan = pFifo->cbOffset - cbOffset;
+      }
+      else
+         *pcbSpan = pFifo->cbBuffer - cbOffset;
+      return (PBYTE)pFifo->pbBuffer + cbOffset;
+   }
+inline VOID FifoCommitWrite (PFIFO pFifo, UI8 cbWritten)
+   {
+      pFifo->cbLength += cbWritten;
+      __FifoHighWater(pFifo, pFifo->cbLength);
+   }
+// block transfers
+inline UI8 FifoReadBlock (PFIFO pFifo, PVOID pvData, UI8 cbData)
+   {
+      UI8 cb = 0;
+      while (cb < cbData)
+      {
+         UI8   cbSpan = 0;
+         PBYTE pbSpan = FifoPeekSpan(pFifo, &cbSpan);
+         if ((cbSpan = Min(cbSpan, cbData - cb)) == 0)
+            break;
+         memcpy((PBYTE)pvData + cb, pbSpan, cbSpan);
+         FifoCommitRead(pFifo, cbSpan);
+         cb += cbSpan;
+      }
+      return cb;
+   }
+inline UI8 FifoWriteBlock (PFIFO pFifo, PCVOID pvData, UI8 cbData)
+   {
+      UI8 cb = 0;
+      while (cb < cbData)
+      {
+         UI8   cbSpan = 0;
+         PBYTE pbSpan = FifoReserveSpan(pFifo, &cbSpan);
+         if ((cbSpan = Min(cbSpan, cbData - cb)) == 0)
+            break;
+         memcpy(pbSpan, (PCBYTE)pvData + cb, cbSpan);
+         FifoCommitWrite(pFifo, cbSpan);
+         cb += cbSpan;
+      }
+      if (cb < cbData)
+      {
+         // apply the overflow policy to the remainder
+         __FifoOverflow(pFifo);
+         switch (pFifo->fPolicy)
+         {
+            case FIFO_POLICY_OVERWRITE:
+               while (cb < cbData)
+               {
+                  pFifo->pbBuffer[pFifo->cbOffset] = ((PCBYTE)pvData)[cb++];
+                  pFifo->cbOffset = (pFifo->cbOffset + 1) % pFifo->cbBuffer;
+               }
+               break;
+            case FIFO_POLICY_DROP:
+               cb = cbData;
+               break;
+         }
+      }
+      return cb;
+   }
+// statistics
+inline PFIFO_STATS FifoGetStats (PFIFO pFifo, PFIFO_STATS pStats)
+   {
+#if FIFO_STATISTICS
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+         *pStats = pFifo->Stats;
+#else
+      IgnoreParam(pFifo);
+      memzero(pStats, sizeof(*pStats));
+#endif
+      return pStats;
+   }
+inline VOID FifoResetStats (PFIFO pFifo)
+   {
+#if FIFO_STATISTICS
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+         memzero((PVOID)&pFifo->Stats, sizeof(pFifo->Stats));
+#else
+      IgnoreParam(pFifo);
+#endif
+   }
+//===========================================================================
+// RING STRUCTURES
+// . single-producer/single-consumer FIFO, safe between an ISR and the
+//   main loop without disabling interrupts
+// . the producer owns nHead and the consumer owns nTail; both are
+//   free-running 8-bit counters, so each update is a single atomic store
+// . the buffer size must be a power of 2 (up to 128), so that offsets
+//   are computed with a mask instead of a division
+// . only the producer may modify the head, so rings support the DROP
+//   and REJECT overflow policies but not OVERWRITE
+// . the producer maintains the high-water and overflow counters, and the
+//   consumer maintains the underflow counter
+//===========================================================================
+// ring data structure
+typedef struct tagRing
+{
+   UI8   cbMask;
+   UI8   nHead;
+   UI8   nTail;
+   UI8   fPolicy;
+   __FifoStats
+   BYTE  pbBuffer[1];
+} RING;
+typedef volatile RING* PRING;
+// ring declaration
+#define DECLARE_RING(name, size)                                           \
+   DECLARE_RING_POLICY(name, size, FIFO_POLICY_REJECT)
+#define DECLARE_RING_POLICY(name, size, policy)                            \
+   _Static_assert(                                                         \
+      (size) > 0 && (size) <= 128 && ((size) & ((size) - 1)) == 0,         \
+      "ring size must be a power of 2 up to 128"                           \
+   );                                                                      \
+   _Static_assert(                                                         \
+      (policy) != FIFO_POLICY_OVERWRITE,                                   \
+      "rings do not support the overwrite policy"                          \
+   );                                                                      \
+   static volatile union                                                   \
+   {                                                                       \
+      RING Ring;                                                           \
+      BYTE pbBuffer[sizeof(RING) + (size) - 1];                            \
+   } __RingBuffer_##name =                                                 \
+      { { .cbMask = (size) - 1, .nHead = 0, .nTail = 0,                    \
+          .fPolicy = policy } };                                           \
+   static PRING name __attribute__((unused)) = &__RingBuffer_##name.Ring
+//===========================================================================
+// RING API
+//===========================================================================
+inline UI8 RingSize (PRING pRing)
+   { return pRing->cbMask + 1; }
+inline UI8 RingCount (PRING pRing)
+   { return (UI8)(pRing->nHead - pRing->nTail); }
+inline BOOL RingIsEmpty (PRING pRing)
+   { return pRing->nHead == pRing->nTail; }
+inline BOOL RingIsFull (PRING pRing)
+   { return RingCount(pRing) > pRing->cbMask; }
+// consumer operations
+inline BYTE RingRead (PRING pRing)
+   {
+      BYTE bData = 0;
+      UI8  nTail = pRing->nTail;
+      if (pRing->nHead != nTail)
+      {
+         bData = pRing->pbBuffer[nTail & pRing->cbMask];
+         pRing->nTail = nTail + 1;
+      }
+      else
+         __FifoUnderflow(pRing);
+      return bData;
+   }
+inline PBYTE RingPeekSpan (PRING pRing, UI8* pcbSpan)
+   {
+      UI8 nTail    = pRing->nTail;
+      UI8 cbOffset = nTail & pRing->cbMask;
+      UI8 cbEnd    = pRing->cbMask + 1 - cbOffset;
+      UI8 cbCount  = pRing->nHead - nTail;
+      *pcbSpan = Min(cbCount, cbEnd);
+      return (PBYTE)pRing->pbBuffer + cbOffset;
+   }
+inline VOID RingCommitRead (PRING pRing, UI8 cbRead)
+   {
+      // finish reading the span before releasing it to the producer
+      MemoryBarrier();
+      pRing->nTail += cbRead;
+   }
+inline UI8 RingReadBlock (PRING pRing, PVOID pvData, UI8 cbData)
+   {
+      UI8 cb = 0;
+      while (cb < cbData)
+      {
+         UI8   cbSpan = 0;
+         PBYTE pbSpan = RingPeekSpan(pRing, &cbSpan);
+         if ((cbSpan = Min(cbSpan, cbData - cb)) == 0)
+            break;
+         memcpy((PBYTE)pvData + cb, pbSpan, cbSpan);
+         RingCommitRead(pRing, cbSpan);
+         cb += cbSpan;
+      }
+      return cb;
+   }
+inline VOID RingFlush (PRING pRing)
+   { pRing->nTail = pRing->nHead; }
+// producer operations
+inline BOOL RingWrite (PRING pRing, BYTE bData)
+   {
+      UI8 nHead  = pRing->nHead;
+      UI8 cbUsed = nHead - pRing->nTail;
+      if (cbUsed > pRing->cbMask)
+      {
+         __FifoOverflow(pRing);
+         return pRing->fPolicy == FIFO_POLICY_DROP;
+      }
+      pRing->pbBuffer[nHead & pRing->cbMask] = bData;
+      pRing->nHead = nHead + 1;
+      __FifoHighWater(pRing, cbUsed + 1);
+      return TRUE;
+   }
+inline PBYTE RingReserveSpan (PRING pRing, UI8* pcbSpan)
+   {
+      UI8 nHead    = pRing->nHead;
+      UI8 cbOffset = nHead & pRing->cbMask;
+      UI8 cbEnd    = pRing->cbMask + 1 - cbOffset;
+      UI8 cbFree   = pRing->cbMask + 1 - (UI8)(nHead - pRing->nTail);
+      *pcbSpan = Min(cbFree, cbEnd);
+      return (PBYTE)pRing->pbBuffer + cbOffset;
+   }
+inline VOID RingCommitWrite (PRING pRing, UI8 cbWritten)
+   {
+      // finish writing the span before publishing it to the consumer
+      MemoryBarrier();
+      pRing->nHead += cbWritten;
+      __FifoHighWater(pRing, RingCount(pRing));
+   }
+inline UI8 RingWriteBlock (PRING pRing, PCVOID pvData, UI8 cbData)
+   {
+      UI8 cb = 0;
+      while (cb < cbData)
+      {
+         UI8   cbSpan = 0;
+         PBYTE pbSpan = RingReserveSpan(pRing, &cbSpan);
+         if ((cbSpan = Min(cbSpan, cbData - cb)) == 0)
+            break;
+         memcpy(pbSpan, (PCBYTE)pvData + cb, cbSpan);
+         RingCommitWrite(pRing, cbSpan);
+         cb += cbSpan;
+      }
+      if (cb < cbData)
+      {
+         // apply the overflow policy to the remainder
+         __FifoOverflow(pRing);
+         if (pRing->fPolicy == FIFO_POLICY_DROP)
+            cb = cbData;
+      }
+      return cb;
+   }
+// statistics
+inline PFIFO_STATS RingGetStats (PRING pRing, PFIFO_STATS pStats)
+   {
+#if FIFO_STATISTICS
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+         *pStats = pRing->Stats;
+#else
+      IgnoreParam(pRing);
+      memzero(pStats, sizeof(*pStats));
+#endif
+      return pStats;
+   }
+inline VOID RingResetStats (PRING pRing)
+   {
+#if FIFO_STATISTICS
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+         memzero((PVOID)&pRing->Stats, sizeof(pRing->Stats));
+#else
+      IgnoreParam(pRing);
+#endif
+   }
 #endif // __FIFO_H
@@ -27,6 +27,7 @@
 // I2C DATA PROTOCOL
 //===========================================================================
 #define ADDR_READ_BIT               0
+#define RECOVER_CLOCKS              9
 //===========================================================================
 // I2C STATUS CODES
 //===========================================================================
@@ -47,6 +48,7 @@
 // miscellaneous status codes
 #define STATUS_NO_STATUS            0xF8  // no relevant state information available; TWINT = “0”
 #define STATUS_BUS_ERROR            0x00  // bus error due to an illegal START or STOP condition
+#define STATUS_MASK                 0xF8  // TWSR status bits, excluding the prescaler bits
 //===========================================================================
 // I2C CONTROL CODES
 //===========================================================================
@@ -64,6 +66,10 @@
    CONTROL_BASE|\
    (0<<TWIE)|(1<<TWINT)| \
    (0<<TWEA)|(0<<TWSTA)|(1<<TWSTO)
+#define CONTROL_RELEASE \
+   CONTROL_BASE|\
+   (0<<TWIE)|(1<<TWINT)| \
+   (0<<TWEA)|(0<<TWSTA)|(0<<TWSTO)
 #define CONTROL_ABORT \
    CONTROL_BASE| \
    (0<<TWIE)|(0<<TWINT)| \
@@ -80,12 +86,43 @@
    CONTROL_BASE| \
    (1<<TWIE)|(1<<TWINT)| \
    (0<<TWEA)|(0<<TWSTA)|(0<<TWSTO)
+//===========================================================================
+// I2C CLOCK VALIDATION
+//===========================================================================
+#if I2C_FREQUENCY > 400000 && !I2C_FAST_MODE_PLUS
+#  error I2C_FREQUENCY above 400kHz requires I2C_FAST_MODE_PLUS
+#elif I2C_FREQUENCY > 1000000 || F_CPU < 16L * (I2C_FREQUENCY)
+#  error I2C_FREQUENCY exceeds the maximum SCL rate (1MHz, F_CPU/16)
+#elif I2C_TWBR > 255
+#  error I2C_FREQUENCY is below the minimum SCL rate (F_CPU/32656)
+#endif
 //-------------------[        Module Variables         ]-------------------//
-static volatile BYTE g_pbBuffer[I2C_BUFFER_SIZE + 1];    // address byte + I2C data
-static volatile UI8  g_cbSend = 0;                       // send count
-static volatile UI8  g_cbRecv = 0;                       // receive count
-static volatile I2C_CALLBACK g_pfnCallback = NULL;       // completion callback
+// transaction queue
+// . the head transaction is the one in progress on the bus
+static PBUS_TRANSACTION volatile g_pHead = NULL;   // queue head
+static PBUS_TRANSACTION volatile g_pTail = NULL;   // queue tail
+// head transfer cursor
+// . the current phase (write or read) of the head transaction, which
+//   spans the transaction buffer for that phase, or each of its segments
+//   with a buffer for that phase
+static BOOL  g_fRecv = FALSE;                      // head in receive phase?
+static BSIZE g_cbPhase = 0;                        // phase bytes remaining
+static PBYTE g_pbXfer = NULL;                      // chunk buffer
+static BSIZE g_cbXfer = 0;                         // chunk bytes remaining
+static PBUS_SEGMENT g_pSegment = NULL;             // next segment
+static UI8   g_cSegments = 0;                      // segments remaining
+static UI8   g_nLastStatus = BUS_STATUS_OK;        // last I2cSendRecv status
+#if I2C_TIMEOUT_TICKS
+static volatile UI8 g_nTicks = 0;                  // head ticks remaining
+#endif
 //-------------------[        Module Prototypes        ]-------------------//
+static VOID I2cBegin (PBUS_TRANSACTION pTrans);
+static BSIZE I2cPhaseLength (PBUS_TRANSACTION pTrans, BOOL fRecv);
+static VOID I2cPhaseStart (PBUS_TRANSACTION pTrans, BOOL fRecv);
+static PBYTE I2cNextByte ();
+static VOID I2cComplete (UI8 nStatus);
+static VOID I2cAbort (UI8 nStatus);
+static VOID I2cRecoverBus ();
 //-------------------[         Implementation          ]-------------------//
 //-----------< FUNCTION: I2cInit >-------------------------------------------
 // Purpose:    I2C interface initialization
@@ -95,10 +132,20 @@ static volatile I2C_CALLBACK g_pfnCallback = NULL;       // completion callback
 VOID I2cInit ()
 {
    // initialize I2C registers
-   TWSR = 0;                                 // prescale the I2C clock at 0, clear status
-   TWBR = (F_CPU / I2C_FREQUENCY - 16) / 2;  // set to 400kHz bit rate
+   TWSR = I2C_TWPS;                          // set the solved clock prescaler
+   TWBR = I2C_TWBR;                          // set the solved bit rate divisor
    TWDR = 0xFF;                              // initialize data to SDA clear
    TWCR = CONTROL_INIT;                      // initialize control register
+#if I2C_TIMEOUT_TICKS
+   // piggyback the timeout tick on timer 2 compare B, starting
+   // the timer if the application has not already done so
+   if ((TCCR2B & AvrClk2Scale(1024)) == 0)
+   {
+      TCCR2A = 0;                            // normal mode
+      TCCR2B = AvrClk2Scale(1024);           // prescale = 1024 (15.625kHz)
+   }
+   OCR2B = 0;                                // match once per period
+#endif
 }
 //-----------< FUNCTION: I2cIsBusy >-----------------------------------------
 // Purpose:    polls the I2C busy state
@@ -108,8 +155,8 @@ VOID I2cInit ()
 //---------------------------------------------------------------------------
 BOOL I2cIsBusy ()
 {
-   // busy if the interrupt is enabled
-   return RegGet(TWCR, TWIE);
+   // busy while any transaction is queued
+   return g_pHead != NULL;
 }
 //-----------< FUNCTION: I2cWait >-------------------------------------------
 // Purpose:    waits for the I2C bus to become available
@@ -121,60 +168,229 @@ VOID I2cWait ()
    while (I2cIsBusy())
       ;
 }
-//-----------< FUNCTION: I2cBeginSendRecv >----------------------------------
-// Purpose:    starts a combined send/receive transaction on the I2C bus
-// Parameters: nSlaveAddr  - address of the slave to receive from
-//             pvSend      - send message buffer
-//             cbSend      - number of bytes to send
-//             cbRecv      - maximum number of bytes to receive
-//             pfnCallback - completion callback
+//-----------< FUNCTION: I2cQueue >------------------------------------------
+// Purpose:    queues a transaction on the I2C bus, starting it if the
+//             bus is idle
+// Parameters: pTrans - the transaction to queue, which must not already
+//                      be queued
 // Returns:    none
 //---------------------------------------------------------------------------
-VOID I2cBeginSendRecv (
-   UI8          nSlaveAddr, 
-   PCVOID       pvSend, 
-   BSIZE        cbSend,
-   BSIZE        cbRecv,
-   I2C_CALLBACK pfnCallback)
+VOID I2cQueue (PBUS_TRANSACTION pTrans)
 {
-   I2cWait();
    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
    {
-      // validate parameters
-      cbSend = Min(cbSend, I2C_BUFFER_SIZE);
-      cbRecv = Min(cbRecv, I2C_BUFFER_SIZE);
-      // set up I2C state
-      if (cbSend == 0)
-         g_pbBuffer[0] = (nSlaveAddr << 1) | BitMask(ADDR_READ_BIT);
+      pTrans->pNext   = NULL;
+      pTrans->fBusy   = TRUE;
+      pTrans->nStatus = BUS_STATUS_BUSY;
+      if (g_pHead == NULL)
+      {
+         g_pHead = g_pTail = pTrans;
+         I2cBegin(pTrans);
+         TWCR = CONTROL_START;
+      }
       else
       {
-         g_pbBuffer[0] = (nSlaveAddr << 1) & BitUnmask(ADDR_READ_BIT);
-         memcpy((PBYTE)g_pbBuffer + 1, pvSend, cbSend);
+         g_pTail->pNext = pTrans;
+         g_pTail = pTrans;
       }
-      g_cbSend = cbSend + 1;
-      g_cbRecv = cbRecv + 1;
-      g_pfnCallback = pfnCallback;
-      // start the data transfer
+   }
+}
+//-----------< FUNCTION: I2cExecute >----------------------------------------
+// Purpose:    executes a transaction synchronously
+// Parameters: pTrans - the transaction to execute
+// Returns:    the transaction status (BUS_STATUS_*)
+//---------------------------------------------------------------------------
+UI8 I2cExecute (PBUS_TRANSACTION pTrans)
+{
+   I2cQueue(pTrans);
+   return BusTransWait(pTrans);
+}
+//-----------< FUNCTION: I2cBegin >------------------------------------------
+// Purpose:    resets the ISR state for the transaction at the head of the
+//             queue, before its START is sent
+// Parameters: pTrans - the head transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID I2cBegin (PBUS_TRANSACTION pTrans)
+{
+   // transactions that only receive skip the send phase
+   I2cPhaseStart(
+      pTrans,
+      I2cPhaseLength(pTrans, FALSE) == 0 && I2cPhaseLength(pTrans, TRUE) != 0
+   );
+#if I2C_TIMEOUT_TICKS
+   // restart the deadline, counting the partial tick in progress
+   g_nTicks = I2C_TIMEOUT_TICKS + 1;
+   RegSetHi(TIFR2, OCF2B);
+   RegSetHi(TIMSK2, OCIE2B);
+#endif
+}
+//-----------< FUNCTION: I2cPhaseLength >------------------------------------
+// Purpose:    calculates the number of bytes in a transaction phase
+// Parameters: pTrans - the transaction to measure
+//             fRecv  - TRUE for the read phase, FALSE for the write phase
+// Returns:    the phase length, in bytes
+//---------------------------------------------------------------------------
+static BSIZE I2cPhaseLength (PBUS_TRANSACTION pTrans, BOOL fRecv)
+{
+   if (pTrans->cSegments == 0)
+   {
+      if (fRecv)
+         return pTrans->pbRecv != NULL ? pTrans->cbRecv : 0;
+      return pTrans->pbSend != NULL ? pTrans->cbSend : 0;
+   }
+   BSIZE cbPhase = 0;
+   for (UI8 i = 0; i < pTrans->cSegments; i++)
+   {
+      PBUS_SEGMENT pSegment = &pTrans->pSegments[i];
+      if ((fRecv ? (PCVOID)pSegment->pbRecv : pSegment->pbSend) != NULL)
+         cbPhase += pSegment->cbData;
+   }
+   return cbPhase;
+}
+//-----------< FUNCTION: I2cPhaseStart >-------------------------------------
+// Purpose:    points the transfer cursor at the start of a phase of the
+//             head transaction
+// Parameters: pTrans - the head transaction
+//             fRecv  - TRUE for the read phase, FALSE for the write phase
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID I2cPhaseStart (PBUS_TRANSACTION pTrans, BOOL fRecv)
+{
+   g_fRecv     = fRecv;
+   g_cbPhase   = I2cPhaseLength(pTrans, fRecv);
+   g_pSegment  = pTrans->pSegments;
+   g_cSegments = pTrans->cSegments;
+   if (g_cSegments == 0)
+   {
+      g_pbXfer = fRecv ? pTrans->pbRecv : (PBYTE)pTrans->pbSend;
+      g_cbXfer = g_cbPhase;
+   }
+   else
+   {
+      g_pbXfer = NULL;
+      g_cbXfer = 0;
+   }
+}
+//-----------< FUNCTION: I2cNextByte >---------------------------------------
+// Purpose:    advances the transfer cursor by one byte, moving on to the
+//             next segment in the current phase as needed
+//             the phase must not be complete
+// Parameters: none
+// Returns:    a pointer to the byte to send or receive
+//---------------------------------------------------------------------------
+static PBYTE I2cNextByte ()
+{
+   while (g_cbXfer == 0)
+   {
+      PBUS_SEGMENT pSegment = g_pSegment++;
+      g_cSegments--;
+      g_pbXfer = g_fRecv ? pSegment->pbRecv : (PBYTE)pSegment->pbSend;
+      g_cbXfer = g_pbXfer != NULL ? pSegment->cbData : 0;
+   }
+   g_cbXfer--;
+   g_cbPhase--;
+   return g_pbXfer++;
+}
+//-----------< FUNCTION: I2cComplete >---------------------------------------
+// Purpose:    completes the transaction at the head of the queue, chaining
+//             the next transaction with a repeated START, or releasing the
+//             bus with a STOP
+// Parameters: nStatus - the transaction status (BUS_STATUS_*)
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID I2cComplete (UI8 nStatus)
+{
+   PBUS_TRANSACTION pTrans = g_pHead;
+   pTrans->nStatus = nStatus;
+   if ((g_pHead = pTrans->pNext) != NULL)
+   {
+      I2cBegin(g_pHead);
       TWCR = CONTROL_START;
    }
+   else
+   {
+      // the bus is only held after a normal completion or a NACK,
+      // otherwise it has already been released
+#if I2C_TIMEOUT_TICKS
+      RegSetLo(TIMSK2, OCIE2B);
+#endif
+      g_pTail = NULL;
+      TWDR = 0xFF;
+      TWCR = nStatus < BUS_STATUS_ARB_LOST ?
+         CONTROL_STOP :
+         CONTROL_RELEASE;
+   }
+   // release the transaction and dispatch the callback,
+   // which may queue it again
+   pTrans->fBusy = FALSE;
+   if (pTrans->pfnOnComplete != NULL)
+      pTrans->pfnOnComplete(pTrans);
 }
-//-----------< FUNCTION: I2cEndSendRecv >------------------------------------
-// Purpose:    completes a send/receive I2C transaction
-// Parameters: nSlaveAddr  - address of the slave to receive from
-//             pvRecv      - return the received bytes via here
-//             cbRecv      - maximum number of bytes to receive
-// Returns:    actual number of bytes received
+//-----------< FUNCTION: I2cAbort >------------------------------------------
+// Purpose:    fails the transaction at the head of the queue after a bus
+//             error or timeout, resetting the TWI and recovering the bus
+//             . called from the TWI or timer ISR; recovery busy-waits for
+//               up to (2 * RECOVER_CLOCKS + 4) * I2C_RECOVER_DELAY us
+//               (110us by default), so interrupts are reenabled while it
+//               runs, with both I2C interrupts masked so that neither
+//               can reenter
+// Parameters: nStatus - the transaction status (BUS_STATUS_*)
+// Returns:    none
 //---------------------------------------------------------------------------
-UI8 I2cEndSendRecv (PVOID pvRecv, UI8 cbRecv)
+static VOID I2cAbort (UI8 nStatus)
 {
-   I2cWait();
-   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+   // disconnect the TWI from the pins, so that the bus
+   // can be driven directly, then reattach it once free
+   TWCR = 0;
+#if I2C_TIMEOUT_TICKS
+   RegSetLo(TIMSK2, OCIE2B);
+#endif
+   NONATOMIC_BLOCK(NONATOMIC_RESTORESTATE)
+      I2cRecoverBus();
+   TWCR = CONTROL_INIT;
+   I2cComplete(nStatus);
+}
+//-----------< FUNCTION: I2cRecoverBus >-------------------------------------
+// Purpose:    frees a bus held by a slave that was interrupted mid-byte
+//             . SCL is clocked until the slave releases SDA (at most 9
+//               times, enough to finish any byte plus its ACK), and then
+//               a STOP is sent to reset the slave's bus state
+//             . the lines are driven open-drain, low via the output
+//               driver and high via the bus pull-ups
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID I2cRecoverBus ()
+{
+   PinSetTriState(PIN_SDA);
+   PinSetTriState(PIN_SCL);
+   _delay_us(I2C_RECOVER_DELAY);
+   // clock out the slave's remaining bits
+   for (UI8 i = 0; i < RECOVER_CLOCKS && !PinRead(PIN_SDA); i++)
    {
-      cbRecv = Min(cbRecv, g_cbRecv);
-      if (pvRecv != NULL)
-         memcpy(pvRecv, (PBYTE)g_pbBuffer + 1, cbRecv);
+      PinSetOutput(PIN_SCL);
+      _delay_us(I2C_RECOVER_DELAY);
+      PinSetInput(PIN_SCL);
+      _delay_us(I2C_RECOVER_DELAY);
    }
-   return cbRecv;
+   // send a STOP (SDA rising while SCL is high)
+   PinSetOutput(PIN_SCL);
+   PinSetOutput(PIN_SDA);
+   _delay_us(I2C_RECOVER_DELAY);
+   PinSetInput(PIN_SCL);
+   _delay_us(I2C_RECOVER_DELAY);
+   PinSetInput(PIN_SDA);
+   _delay_us(I2C_RECOVER_DELAY);
+}
+//-----------< FUNCTION: I2cGetLastStatus >----------------------------------
+// Purpose:    retrieves the status of the last I2cSendRecv call
+// Parameters: none
+// Returns:    the transaction status (BUS_STATUS_*)
+//---------------------------------------------------------------------------
+UI8 I2cGetLastStatus ()
+{
+   return g_nLastStatus;
 }
 //-----------< FUNCTION: I2cSendRecv >---------------------------------------
 // Purpose:    executes a combined send/receive transaction on the I2C bus
@@ -182,20 +398,29 @@ UI8 I2cEndSendRecv (PVOID pvRecv, UI8 cbRecv)
 //             pvSend     - send message buffer
 //             cbSend     - number of bytes to send
 //             pvRecv     - receive message buffer
-//             cbRecv     - maximum number of bytes to receive
-// Returns:    the actual number of bytes received
+//             cbRecv     - number of bytes to receive
+// Returns:    the actual number of bytes received, 0 on failure
+//             (see I2cGetLastStatus)
 //---------------------------------------------------------------------------
-UI8 I2cSendRecv (
+BSIZE I2cSendRecv (
    UI8    nSlaveAddr, 
    PCVOID pvSend, 
    BSIZE  cbSend,
    PVOID  pvRecv, 
    BSIZE  cbRecv)
 {
-   I2cBeginSendRecv(nSlaveAddr, pvSend, cbSend, cbRecv, NULL);
-   if (pvRecv != NULL)
-      return I2cEndSendRecv(pvRecv, cbRecv);
-   return 0;
+   // exchange directly with the caller's buffers
+   BUS_TRANSACTION trans =
+   {
+      .nAddress = nSlaveAddr,
+      .pbSend   = pvSend,
+      .cbSend   = cbSend,
+      .pbRecv   = pvRecv,
+      .cbRecv   = cbRecv
+   };
+   if ((g_nLastStatus = I2cExecute(&trans)) != BUS_STATUS_OK)
+      return 0;
+   return pvRecv != NULL ? cbRecv : 0;
 }
 //-----------< INTERRUPT: TWI_vect >-----------------------------------------
 // Purpose:    responds to I2C events
@@ -204,69 +429,77 @@ UI8 I2cSendRecv (
 //---------------------------------------------------------------------------
 ISR(TWI_vect)
 {
-   static volatile UI8 g_cbOffset = 0;
-   switch (TWSR)
+   PBUS_TRANSACTION pTrans = g_pHead;
+   switch (TWSR & STATUS_MASK)
    {
       case STATUS_START:                           // START transmitted
       case STATUS_REP_START:                       // re-START transmitted
-         g_cbOffset = 0;
+         // address the slave for the current phase
+         TWDR = (pTrans->nAddress << 1) | (g_fRecv << ADDR_READ_BIT);
+         TWCR = CONTROL_XFER_DATA;
+         break;
       case STATUS_MTX_ADR_ACK:                     // address byte transmitted
       case STATUS_MTX_DATA_ACK:                    // data byte transmitted
-         if (g_cbOffset < g_cbSend)
+         if (g_cbPhase != 0)
          {
             // keep on sending
-            TWDR = g_pbBuffer[g_cbOffset++];
+            TWDR = *I2cNextByte();
             TWCR = CONTROL_XFER_DATA;
          }
-         else if (g_cbRecv != 1)
+         else if (I2cPhaseLength(pTrans, TRUE) != 0)
          {
             // send complete, but combination
             // transaction, so restart in read mode
-            g_pbBuffer[0] |= BitMask(ADDR_READ_BIT);
+            I2cPhaseStart(pTrans, TRUE);
             TWCR = CONTROL_START;
          }
          else
          {
-            // send complete, so stop
-            TWDR = 0xFF;
-            TWCR = CONTROL_STOP;
-            if (g_pfnCallback != NULL)
-               g_pfnCallback();
+            // send complete, so chain or stop
+            I2cComplete(BUS_STATUS_OK);
          }
          break;
-      case STATUS_ARB_LOST:                        // arbitration lost, restart
-         // combination send/receive transaction,
-         // so clear the read bit and restart
-         if (g_cbSend != 1)
-            g_pbBuffer[0] &= BitUnmask(ADDR_READ_BIT);
-         TWCR = CONTROL_START;
+      case STATUS_ARB_LOST:                        // arbitration lost
+         // another master (or noise) has taken the bus, so
+         // report it and leave any retry to the caller
+         I2cComplete(BUS_STATUS_ARB_LOST);
          break;
       case STATUS_MRX_DATA_ACK:                    // data byte received, ACK transmitted
-         g_pbBuffer[g_cbOffset++] = TWDR;
+         *I2cNextByte() = TWDR;
       case STATUS_MRX_ADR_ACK:                     // address byte transmitted
-         if (g_cbOffset < g_cbRecv - 1)
+         // ACK all but the last byte
+         if (g_cbPhase > 1)
             TWCR = CONTROL_SEND_ACK;
          else
             TWCR = CONTROL_SEND_NACK;
          break;
       case STATUS_MRX_DATA_NACK:                   // data byte received, NACK transmitted
-         g_cbRecv = g_cbOffset;
-         g_pbBuffer[g_cbOffset] = TWDR;
-         TWDR = 0xFF;
-         TWCR = CONTROL_STOP;
-         if (g_pfnCallback != NULL)
-            g_pfnCallback();
+         *I2cNextByte() = TWDR;
+         I2cComplete(BUS_STATUS_OK);
          break;
       case STATUS_MTX_ADR_NACK:                    // error - NACK was received after address
-      case STATUS_MTX_DATA_NACK:                   // error - NACK was received after data
       case STATUS_MRX_ADR_NACK:                    // error - NACK was received after address
+         I2cComplete(BUS_STATUS_ADDR_NACK);
+         break;
+      case STATUS_MTX_DATA_NACK:                   // error - NACK was received after data
+         I2cComplete(BUS_STATUS_DATA_NACK);
+         break;
       case STATUS_BUS_ERROR:                       // general error
       default:                                     // unknown error
-         g_cbRecv = 0;
-         TWDR = 0xFF;
-         TWCR = CONTROL_ABORT;
-         if (g_pfnCallback != NULL)
-            g_pfnCallback();
+         I2cAbort(BUS_STATUS_BUS_ERROR);
          break;
    }
 }
+#if I2C_TIMEOUT_TICKS
+//-----------< INTERRUPT: TIMER2_COMPB_vect >--------------------------------
+// Purpose:    counts down the deadline of the transaction in progress,
+//             failing it if the bus or the TWI has stalled
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+ISR(TIMER2_COMPB_vect)
+{
+   if (g_pHead != NULL && --g_nTicks == 0)
+      I2cAbort(BUS_STATUS_TIMEOUT);
+}
+#endif
@@ -26,46 +26,114 @@
 #ifndef __AVRDEFS_H
 #include "avrdefs.h"
 #endif
+#ifndef __BUS_H
+#include "bus.h"
+#endif
 //-------------------[       Module Definitions        ]-------------------//
 //===========================================================================
 // I2C CONFIGURATION
 // . I2C_FREQUENCY            I2C frequency, in Hz
-// . I2C_BUFFER_SIZE          size of the I2C send/receive buffer, in bytes
+//                            (the closest rate that does not exceed this
+//                            is used, see I2C_ACTUAL_FREQUENCY)
+// . I2C_FAST_MODE_PLUS       set to 1 to allow frequencies above 400kHz,
+//                            up to 1MHz (F_CPU/16 at most), when every
+//                            device and the bus pull-ups support
+//                            Fast-mode Plus
+// . I2C_TIMEOUT_TICKS        transaction deadline, in timer 2 periods
+//                            (0, the default, disables timeouts)
+//   . enabling timeouts claims timer 2 compare B (OCR2B, OC2B and the
+//     TIMER2_COMPB interrupt), which fires once per timer 2 period in
+//     any mode, so the application may still use timer 2 otherwise, but
+//     the tick length follows whatever period it gives the timer
+//   . if timer 2 is stopped at I2cInit, it is started in normal mode at
+//     F_CPU/1024/256 (16.384ms per tick at 16MHz)
+//   . the UART idle timeout (UART_RECV_IDLE) reprograms timer 2 and
+//     resets it on every received byte, which stretches the deadline,
+//     so it must use timer 0 (UART_RECV_IDLE_TIMER=0) with timeouts on
+//   . a transaction that does not complete within I2C_TIMEOUT_TICKS to
+//     I2C_TIMEOUT_TICKS + 1 ticks of its START is failed with
+//     BUS_STATUS_TIMEOUT, and the bus is recovered
+// . I2C_RECOVER_DELAY        bus recovery SCL half-period, in us
+//   . recovery runs from the I2C ISRs, with interrupts reenabled, and
+//     takes up to 22 half-periods (110us by default)
 //===========================================================================
 #ifndef I2C_FREQUENCY
 #  define I2C_FREQUENCY       400000
 #endif
-#ifndef I2C_BUFFER_SIZE
-#  define I2C_BUFFER_SIZE     16
+#ifndef I2C_FAST_MODE_PLUS
+#  define I2C_FAST_MODE_PLUS  0
+#endif
+#ifndef I2C_TIMEOUT_TICKS
+#  define I2C_TIMEOUT_TICKS   0
+#endif
+#if I2C_TIMEOUT_TICKS && defined(UART_RECV_IDLE) && UART_RECV_IDLE && \
+   (!defined(UART_RECV_IDLE_TIMER) || UART_RECV_IDLE_TIMER == 2)
+#  error I2C_TIMEOUT_TICKS and UART_RECV_IDLE both use timer 2, set UART_RECV_IDLE_TIMER=0
 #endif
+#ifndef I2C_RECOVER_DELAY
+#  define I2C_RECOVER_DELAY   5
+#endif
+//===========================================================================
+// I2C CLOCK
+// . SCL = F_CPU / (16 + 2 * TWBR * prescale), prescale = 4^TWPS
+// . the solver picks the smallest prescaler whose TWBR fits in 8 bits
+//   (for the finest resolution), and rounds TWBR up so that the actual
+//   frequency is the closest one that does not exceed I2C_FREQUENCY
+// . I2C_ACTUAL_FREQUENCY reports the resulting SCL frequency, in Hz
+//===========================================================================
+#define __I2C_TWBR(f, ps)                                                  \
+   ((((F_CPU) + (f) - 1) / (f) - 16 + 2 * (ps) - 1) / (2 * (ps)))
+#define __I2C_PRESCALE(f)                                                  \
+   (__I2C_TWBR(f,  1) <= 255 ?  1 : __I2C_TWBR(f,  4) <= 255 ?  4 :        \
+    __I2C_TWBR(f, 16) <= 255 ? 16 : 64)
+#define __I2C_TWPS(ps)                                                     \
+   ((ps) == 1 ? 0 : (ps) == 4 ? 1 : (ps) == 16 ? 2 : 3)
+#define I2C_TWBR                                                           \
+   __I2C_TWBR(I2C_FREQUENCY, __I2C_PRESCALE(I2C_FREQUENCY))
+#define I2C_TWPS                                                           \
+   __I2C_TWPS(__I2C_PRESCALE(I2C_FREQUENCY))
+#define I2C_ACTUAL_FREQUENCY                                               \
+   ((F_CPU) / (16 + 2 * I2C_TWBR * __I2C_PRESCALE(I2C_FREQUENCY)))
+//===========================================================================
+// I2C TRANSACTIONS
+// . I2C transactions are bus transactions (see bus.h), addressed by 7-bit
+//   slave address, which are queued with I2cQueue or run synchronously
+//   with I2cExecute; the SPI device (pvDevice) is ignored
+// . cbSend bytes are written, then cbRecv bytes are read after a repeated
+//   START (a transaction with neither just addresses the slave); for a
+//   segmented transaction, the send segments are written, then the
+//   receive segments are read
+// . the TWI ISR chains each queued transaction onto the previous one with
+//   a repeated START, and only releases the bus with a STOP when the
+//   queue is empty
+// . data is sent from and received directly into the caller's buffers,
+//   which may be of any length
+// . after a bus error or timeout, the TWI is reset and the bus is
+//   recovered by clocking SCL (up to 9 times) until the slave releases
+//   SDA, followed by a STOP; the queue then continues with the next
+//   transaction, so a failed transfer costs only that transaction
+//===========================================================================
 //===========================================================================
 // I2C INTERFACE
 //===========================================================================
-// I2C callback
-typedef VOID (*I2C_CALLBACK)  ();
 // I2C API
 VOID     I2cInit           ();
 BOOL     I2cIsBusy         ();
 VOID     I2cWait           ();
-VOID     I2cBeginSendRecv  (UI8          nSlaveAddr, 
-                            PCVOID       pvSend, 
-                            BSIZE        cbSend,
-                            BSIZE        cbRecv,
-                            I2C_CALLBACK pfnCallback);
-UI8      I2cEndSendRecv    (PVOID        pvRecv, 
-                            UI8          cbRecv);
-UI8      I2cSendRecv       (UI8          nSlaveAddr, 
+VOID     I2cQueue          (PBUS_TRANSACTION pTrans);
+UI8      I2cExecute        (PBUS_TRANSACTION pTrans);
+UI8      I2cGetLastStatus  ();
+BSIZE    I2cSendRecv       (UI8          nSlaveAddr, 
                             PCVOID       pvSend, 
                             BSIZE        cbSend,
                             PVOID        pvRecv, 
                             BSIZE        cbRecv);
 // I2C one-way helpers
 inline VOID I2cSend (UI8 nSlaveAddr, PCVOID pvSend, BSIZE cbSend)
-   { I2cBeginSendRecv(nSlaveAddr, pvSend, cbSend, 0, NULL); }
-inline VOID I2cBeginRecv (UI8 nSlaveAddr, BSIZE cbRecv, I2C_CALLBACK pfnCallback)
-   { I2cBeginSendRecv(nSlaveAddr, NULL, 0, cbRecv, pfnCallback); }
-inline UI8 I2cEndRecv (PVOID pvRecv, BSIZE cbRecv)
-   { return I2cEndSendRecv(pvRecv, cbRecv); }
-inline UI8 I2cRecv (UI8 nSlaveAddr, PVOID pvRecv, BSIZE cbRecv)
+   { I2cSendRecv(nSlaveAddr, pvSend, cbSend, NULL, 0); }
+inline BSIZE I2cRecv (UI8 nSlaveAddr, PVOID pvRecv, BSIZE cbRecv)
    { return I2cSendRecv(nSlaveAddr, NULL, 0, pvRecv, cbRecv); }
+// I2C bus interface initializer
+#define I2C_BUS                                                            \
+   { .pfnQueue = I2cQueue, .pfnExecute = I2cExecute }
 #endif // __I2CMAST_H
@@ -25,15 +25,13 @@
 #include "mpu6050.h"
 #include "i2cmast.h"
 //-------------------[       Module Definitions        ]-------------------//
-#if I2C_BUFFER_SIZE < 15
-#  error The I2C buffer size is too small for MPU-6050.
-#endif
 //===========================================================================
 // MPU6050 REGISTER ADDRESSES
 //===========================================================================
 #define REGISTER_CONFIG             0x1A
 #define REGISTER_GYROCONFIG         0x1B
 #define REGISTER_ACCELCONFIG        0x1C
+#define REGISTER_FIFO_EN            0x23
 #define REGISTER_ACCEL_X            0x3B
 #define REGISTER_ACCEL_Y            0x3D
 #define REGISTER_ACCEL_Z            0x3F
@@ -44,7 +42,10 @@
 #define REGISTER_GYRO_Z             0x47
 #define REGISTER_GYRO_START         REGISTER_GYRO_X
 #define REGISTER_SENSOR_START       REGISTER_ACCEL_START
+#define REGISTER_USER_CTRL          0x6A
 #define REGISTER_PWR_MGMT_1         0x6B
+#define REGISTER_FIFO_COUNT         0x72
+#define REGISTER_FIFO_R_W           0x74
 //===========================================================================
 // SAMPLE SCALE FACTORS
 //===========================================================================
@@ -53,6 +54,17 @@
 #define TEMP_SENSOR_RANGE           340.0f
 #define TEMP_SENSOR_OFFSET          35.0f
 //-------------------[        Module Variables         ]-------------------//
+// async sensor read transaction
+static const BYTE g_bSensorRegister = REGISTER_SENSOR_START;
+static BYTE g_pbSensors[14];
+static BUS_TRANSACTION g_SensorTrans =
+{
+   .nAddress = MPU6050_I2CADDR,
+   .pbSend   = &g_bSensorRegister,
+   .cbSend   = 1,
+   .pbRecv   = g_pbSensors,
+   .cbRecv   = sizeof(g_pbSensors)
+};
 //-------------------[        Module Prototypes        ]-------------------//
 //-------------------[         Implementation          ]-------------------//
 //-----------< FUNCTION: DecodeI16 >-----------------------------------------
@@ -65,27 +77,6 @@ static I16 DecodeI16 (PBYTE pbData, UI8 nIndex)
 {
    return ((I16)pbData[2 * nIndex] << 8) | pbData[2 * nIndex + 1];
 }
-//-----------< FUNCTION: BeginReadRegister >---------------------------------
-// Purpose:    begins an asynchronous read of an MPU6050 register over I2C
-// Parameters: nRegister - register address
-//             cbData    - the number of bytes to read
-// Returns:    none
-//---------------------------------------------------------------------------
-static VOID BeginReadRegister (UI8 nRegister, UI8 cbData)
-{
-   I2cBeginSendRecv(MPU6050_I2CADDR, &nRegister, 1, cbData, NULL);
-}
-//-----------< FUNCTION: EndReadRegister >-----------------------------------
-// Purpose:    ends an asynchronous read of an MPU6050 register over I2C
-// Parameters: pvData - return register data via here
-//             cbData - the number of bytes to read
-// Returns:    pvData
-//---------------------------------------------------------------------------
-static PVOID EndReadRegister (PVOID pvData, UI8 cbData)
-{
-   I2cEndSendRecv(pvData, cbData);
-   return pvData;
-}
 //-----------< FUNCTION: ReadRegister >--------------------------------------
 // Purpose:    reads an MPU6050 register over I2C
 // Parameters: nRegister - register address
@@ -93,10 +84,10 @@ static PVOID EndReadRegister (PVOID pvData, UI8 cbData)
 //             cbData    - the number of bytes to read
 // Returns:    pvData
 //---------------------------------------------------------------------------
-static PVOID ReadRegister (UI8 nRegister, PVOID pvData, UI8 cbData)
+static PVOID ReadRegister (UI8 nRegister, PVOID pvData, BSIZE cbData)
 {
-   BeginReadRegister(nRegister, cbData);
-   EndReadRegister(pvData, cbData);
+   // receive directly into the caller's buffer
+   I2cSendRecv(MPU6050_I2CADDR, &nRegister, 1, pvData, cbData);
    return pvData;
 }
 //-----------< FUNCTION: WriteRegister >-------------------------------------
@@ -108,11 +99,19 @@ static PVOID ReadRegister (UI8 nRegister, PVOID pvData, UI8 cbData)
 //---------------------------------------------------------------------------
 static VOID WriteRegister (UI8 nRegister, PVOID pvData, UI8 cbData)
 {
-   UI8  cbSend = cbData + 1;
-   BYTE pbSend[cbSend];
-   pbSend[0] = nRegister;
-   memcpy(pbSend + 1, pvData, cbData);
-   I2cSend(MPU6050_I2CADDR, pbSend, cbSend);
+   // send the register address and the caller's data in one write
+   BUS_SEGMENT pSegments[] =
+   {
+      { .pbSend = &nRegister, .pbRecv = NULL, .cbData = 1 },
+      { .pbSend = pvData,     .pbRecv = NULL, .cbData = cbData }
+   };
+   BUS_TRANSACTION trans =
+   {
+      .nAddress  = MPU6050_I2CADDR,
+      .pSegments = pSegments,
+      .cSegments = 2
+   };
+   I2cExecute(&trans);
 }
 //-----------< FUNCTION: ReadRegister8 >-------------------------------------
 // Purpose:    reads an MPU6050 8-bit register over I2C
@@ -353,31 +352,35 @@ MPU6050_VECTOR* Mpu6050ReadGyro (MPU6050_VECTOR* pGyro)
 //-----------< FUNCTION: Mpu6050BeginReadSensors >---------------------------
 // Purpose:    begins an asynchronous read of all sensors from the 
 //             MPU-6050 in one I2C transaction
+//             the read is queued behind any other I2C transactions,
+//             so it does not block while the bus is busy
 // Parameters: none
 // Returns:    none
 //---------------------------------------------------------------------------
 VOID Mpu6050BeginReadSensors ()
 {
-   BeginReadRegister(REGISTER_SENSOR_START, 14);
+   BusTransWait(&g_SensorTrans);
+   I2cQueue(&g_SensorTrans);
 }
 //-----------< FUNCTION: Mpu6050EndReadSensors >-----------------------------
 // Purpose:    completes an asynchronous read of all sensors from the 
 //             MPU-6050 in one I2C transaction
 // Parameters: pSensors - return the result via here
 //                        a structure containing the sensor readings
-// Returns:    pSensors
+// Returns:    pSensors if successful
+//             NULL if the read failed (pSensors is unchanged)
 //---------------------------------------------------------------------------
 MPU6050_SENSORS* Mpu6050EndReadSensors (MPU6050_SENSORS* pSensors)
 {
    // complete the async read
-   BYTE pbBuffer[14];
-   EndReadRegister(pbBuffer, sizeof(pbBuffer));
+   if (BusTransWait(&g_SensorTrans) != BUS_STATUS_OK)
+      return NULL;
    // decode the sensor readings from the buffer
    for (UI8 i = 0; i < 3; i++)
-      pSensors->Accel.v[i] = (F32)DecodeI16(pbBuffer, i) / ACCEL_SENSOR_RANGE;
-   pSensors->Temp = (F32)DecodeI16(pbBuffer, 3) / TEMP_SENSOR_RANGE + TEMP_SENSOR_OFFSET;
+      pSensors->Accel.v[i] = (F32)DecodeI16(g_pbSensors, i) / ACCEL_SENSOR_RANGE;
+   pSensors->Temp = (F32)DecodeI16(g_pbSensors, 3) / TEMP_SENSOR_RANGE + TEMP_SENSOR_OFFSET;
    for (UI8 i = 0; i < 3; i++)
-      pSensors->Gyro.v[i] = (F32)DecodeI16(pbBuffer, i + 4) / GYRO_SENSOR_RANGE;
+      pSensors->Gyro.v[i] = (F32)DecodeI16(g_pbSensors, i + 4) / GYRO_SENSOR_RANGE;
    return pSensors;
 }
 //-----------< FUNCTION: Mpu6050Reset >--------------------------------------
@@ -499,3 +502,84 @@ VOID Mpu6050SetClockSource (UI8 nSource)
       (ReadRegister8(REGISTER_PWR_MGMT_1) & ~0x7) | (nSource & 0x7)
    );
 }
+//-----------< FUNCTION: Mpu6050GetFifoSources >----------------------------
+// Purpose:    reads the set of sensors that are written to the FIFO
+// Parameters: none
+// Returns:    the current FIFO sources (MPU6050_FIFO_*)
+//---------------------------------------------------------------------------
+UI8 Mpu6050GetFifoSources ()
+{
+   return ReadRegister8(REGISTER_FIFO_EN) & MPU6050_FIFO_SENSORS;
+}
+//-----------< FUNCTION: Mpu6050SetFifoSources >----------------------------
+// Purpose:    selects the sensors that are written to the FIFO
+// Parameters: fSources - the FIFO sources to assign (MPU6050_FIFO_*)
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID Mpu6050SetFifoSources (UI8 fSources)
+{
+   WriteRegister8(
+      REGISTER_FIFO_EN,
+      (ReadRegister8(REGISTER_FIFO_EN) & ~MPU6050_FIFO_SENSORS) |
+      (fSources & MPU6050_FIFO_SENSORS)
+   );
+}
+//-----------< FUNCTION: Mpu6050IsFifoEnabled >------------------------------
+// Purpose:    determines whether the sensor FIFO is enabled
+// Parameters: none
+// Returns:    true if the FIFO is enabled
+//             false otherwise
+//---------------------------------------------------------------------------
+BOOL Mpu6050IsFifoEnabled ()
+{
+   return BitTest(ReadRegister8(REGISTER_USER_CTRL), 6);
+}
+//-----------< FUNCTION: Mpu6050SetFifoEnabled >-----------------------------
+// Purpose:    enables/disables the sensor FIFO
+// Parameters: fEnabled - true to enable the FIFO
+//                        false to disable the FIFO
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID Mpu6050SetFifoEnabled (BOOL fEnabled)
+{
+   WriteRegister8(
+      REGISTER_USER_CTRL,
+      BitSet(ReadRegister8(REGISTER_USER_CTRL), 6, fEnabled)
+   );
+}
+//-----------< FUNCTION: Mpu6050ResetFifo >----------------------------------
+// Purpose:    discards the contents of the sensor FIFO
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID Mpu6050ResetFifo ()
+{
+   WriteRegister8(
+      REGISTER_USER_CTRL,
+      BitSetHi(ReadRegister8(REGISTER_USER_CTRL), 2)
+   );
+}
+//-----------< FUNCTION: Mpu6050GetFifoCount >-------------------------------
+// Purpose:    reads the number of bytes in the sensor FIFO
+// Parameters: none
+// Returns:    the FIFO byte count
+//---------------------------------------------------------------------------
+UI16 Mpu6050GetFifoCount ()
+{
+   BYTE pbCount[2];
+   ReadRegister(REGISTER_FIFO_COUNT, pbCount, sizeof(pbCount));
+   return ((UI16)pbCount[0] << 8) | pbCount[1];
+}
+//-----------< FUNCTION: Mpu6050ReadFifo >-----------------------------------
+// Purpose:    burst reads the sensor FIFO in one I2C transaction
+//             directly into the caller's buffer
+// Parameters: pvData - return the FIFO contents via here
+//             cbData - the number of bytes to read, which should not
+//                      exceed the FIFO count (up to MPU6050_FIFO_SIZE)
+// Returns:    the number of bytes read
+//---------------------------------------------------------------------------
+BSIZE Mpu6050ReadFifo (PVOID pvData, BSIZE cbData)
+{
+   BYTE nRegister = REGISTER_FIFO_R_W;
+   return I2cSendRecv(MPU6050_I2CADDR, &nRegister, 1, pvData, cbData);
+}
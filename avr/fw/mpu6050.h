@@ -99,6 +99,14 @@ typedef struct tagMpu6050Sensors
 #define MPU6050_CLOCK_EXTERNAL32KHZ 0x4      // external 32kHz clock
 #define MPU6050_CLOCK_EXTERNAL19HZ  0x5      // external 19kHz clock
 #define MPU6050_CLOCK_NONE          0x7      // stops the clock
+// FIFO sources
+#define MPU6050_FIFO_SIZE           1024     // FIFO capacity, in bytes
+#define MPU6050_FIFO_TEMP           0x80     // temperature sensor
+#define MPU6050_FIFO_GYRO_X         0x40     // x-axis gyroscope
+#define MPU6050_FIFO_GYRO_Y         0x20     // y-axis gyroscope
+#define MPU6050_FIFO_GYRO_Z         0x10     // z-axis gyroscope
+#define MPU6050_FIFO_ACCEL          0x08     // all accelerometer axes
+#define MPU6050_FIFO_SENSORS        0xF8     // all sensors
 //===========================================================================
 // MODULE API
 //===========================================================================
@@ -139,6 +147,14 @@ BOOL              Mpu6050IsTempDisabled      ();
 VOID              Mpu6050SetTempDisabled     (BOOL fDisabled);
 UI8               Mpu6050GetClockSource      ();
 VOID              Mpu6050SetClockSource      (UI8 nSource);
+// FIFO registers
+UI8               Mpu6050GetFifoSources      ();
+VOID              Mpu6050SetFifoSources      (UI8 fSources);
+BOOL              Mpu6050IsFifoEnabled       ();
+VOID              Mpu6050SetFifoEnabled      (BOOL fEnabled);
+VOID              Mpu6050ResetFifo           ();
+UI16              Mpu6050GetFifoCount        ();
+BSIZE             Mpu6050ReadFifo            (PVOID pvData, BSIZE cbData);
 // register helpers
 inline F32 Mpu6050GetGyroSelfTestX ()
    { return Mpu6050GetGyroSelfTest(MPU6050_AXIS_X); }
@@ -29,8 +29,10 @@
 //===========================================================================
 #define COMMAND_READREGISTER        0x00
 #define COMMAND_WRITEREGISTER       0x20
+#define COMMAND_RXREADLENGTH        0x60
 #define COMMAND_RXREADPACKET        0x61
 #define COMMAND_TXWRITEPACKET       0xA0
+#define COMMAND_ACKWRITEPACKET      0xA8
 #define COMMAND_TXFLUSH             0xE1
 #define COMMAND_RXFLUSH             0xE2
 #define COMMAND_TXREUSE             0xE3
@@ -66,14 +68,133 @@
 #define REGISTER_FIFOSTATUS         0x17
 #define REGISTER_DYNPAYLOAD         0x1C
 #define REGISTER_FEATURE            0x1D
+//===========================================================================
+// IRQ CONFIGURATION
+//===========================================================================
+#if NRF24_RECV_SLOTS < 1 || NRF24_RECV_SLOTS > 128 || \
+    (NRF24_RECV_SLOTS & (NRF24_RECV_SLOTS - 1)) != 0
+#  error NRF24_RECV_SLOTS must be a power of 2 up to 128
+#endif
+// received packet slot
+typedef struct tagNrf24Slot
+{
+   UI8   nPipe;                           // receive pipe
+   UI8   cbPacket;                        // packet length
+   BYTE  pbPacket[NRF24_PACKET_MAX];      // packet data
+} NRF24_SLOT, *PNRF24_SLOT;
 //-------------------[        Module Variables         ]-------------------//
+static BUS  g_Bus          = SPI_BUS;              // SPI bus interface
 static UI8  g_nSsPin       = PIN_INVALID;          // slave select pin
 static UI8  g_nCePin       = PIN_INVALID;          // chip enable pin
 static UI8  g_cbAddress    = 5;                    // address width
-static BOOL g_bTXRecvAck   = TRUE;                 // enable TX acks?
 static BOOL g_fPowerMode   = NRF24_MODE_OFF;       // powered up?
+// configuration register shadows
+// . the driver is the only writer of these registers, so it keeps a copy
+//   of each, initialized to the power on reset values and written through
+//   on every change; getters read the copy and setters write the register
+//   once, without reading it back first
+// . Nrf24Init writes every shadowed register, so that the copies are
+//   coherent even if only the MCU was reset
+static BYTE g_bConfig      = 0x08;                 // CONFIG
+static BYTE g_bAutoAck     = 0x3F;                 // EN_AA
+static BYTE g_bRXEnabled   = 0x03;                 // EN_RXADDR
+static BYTE g_bAutoRetry   = 0x03;                 // SETUP_RETR
+static BYTE g_bRFChannel   = 0x02;                 // RF_CH
+static BYTE g_bRFConfig    = 0x0F;                 // RF_SETUP
+static BYTE g_bDynPayload  = 0x00;                 // DYNPD
+static BYTE g_bFeature     = 0x00;                 // FEATURE
+static UI8  g_pcbPayload[NRF24_PIPE_COUNT];        // RX_PW_P*
+// STATUS register cache
+// . the NRF24 clocks out STATUS as the first byte of every command, so it
+//   is captured from each transaction and stamped with the status clock,
+//   which the caller advances via Nrf24Tick
+// . commands that change the FIFO state report STATUS from before the
+//   change, so they either patch the cached value or invalidate it
+static BYTE g_bStatus      = 0x0E;                 // last captured STATUS
+static BOOL g_fStatusValid = FALSE;                // cached STATUS usable?
+static UI8  g_nStatusTime  = 0;                    // clock at capture
+static UI8  g_nStatusClock = 0;                    // current status clock
+// async packet transfer state
+// . the packet segment references the caller's buffer directly, which
+//   must remain valid until Nrf24EndSend/Nrf24EndRecv
+static BYTE g_bPacketCommand = COMMAND_NOOP;       // packet command byte
+static BYTE g_bPacketStatus  = 0x0E;               // STATUS before transfer
+static BUS_SEGMENT g_pPacketSegments[2] =          // command, packet
+{
+   { .pbSend = &g_bPacketCommand, .pbRecv = &g_bPacketStatus, .cbData = 1 },
+   { .pbSend = NULL,              .pbRecv = NULL, .cbData = 0 }
+};
+static BUS_TRANSACTION g_PacketTrans =             // packet transaction
+{
+   .pSegments = g_pPacketSegments,
+   .cSegments = 2
+};
+// IRQ service state
+// . the NRF24 IRQs are serviced by a chain of queued bus transactions,
+//   each started from the completion callback of the last, so that no
+//   SPI transfer waits in interrupt context
+// . the chain is started from the IRQ pin handler, if configured, or
+//   else by Nrf24Poll, and also by Nrf24QueueSend to load the TX FIFO
+static NRF24_CALLBACK   g_pfnOnIrq     = NULL;           // IRQ callback
+static volatile BOOL    g_fIrqActive   = FALSE;          // chain running?
+static volatile BOOL    g_fIrqPending  = FALSE;          // IRQ during chain?
+static UI8              g_fIrqFlags    = NRF24_IRQ_NONE; // IRQs handled
+static UI8              g_fSendIrq     = NRF24_IRQ_NONE; // TX IRQs pending
+static BYTE             g_pbIrqCommand[2];               // chain command
+static BYTE             g_pbIrqStatus[2];                // STATUS (+ data)
+static BUS_SEGMENT      g_pIrqSegments[2];               // command, packet
+static BUS_TRANSACTION  g_IrqTrans;                      // chain transaction
+// send queue
+// . queued packets are linked from head to tail; the first
+//   g_cSendInFlight of them have been loaded into the TX FIFO, and
+//   g_pSendNext is the next one to load
+// . CE is held high while packets are in flight, and each TX_DS (or
+//   MAX_RT) completes the packets that have left the TX FIFO
+static PNRF24_PACKET volatile g_pSendHead = NULL;        // oldest packet
+static PNRF24_PACKET    g_pSendTail    = NULL;           // newest packet
+static PNRF24_PACKET    g_pSendNext    = NULL;           // next to load
+static UI8              g_cSendInFlight = 0;             // loaded packets
+#ifdef NRF24_IRQ_VECTOR
+// interrupt-driven receive state
+// . packets are buffered in a slot ring; the IRQ chain owns the head
+//   and Nrf24EndRecv owns the tail, as for the fifo.h rings
+// . if the ring fills, the chain leaves the remaining packets in the
+//   RX FIFO until Nrf24EndRecv frees a slot and restarts it
+static UI8              g_nIrqPin      = PIN_INVALID;    // IRQ input pin
+static volatile BOOL    g_fRecvStalled = FALSE;          // ring was full?
+static NRF24_SLOT       g_pRecvSlots[NRF24_RECV_SLOTS];  // packet ring
+static volatile UI8     g_nRecvHead    = 0;              // ring producer
+static volatile UI8     g_nRecvTail    = 0;              // ring consumer
+#endif
 //-------------------[        Module Prototypes        ]-------------------//
+static VOID IrqStart          ();
+static VOID IrqClearStatus    ();
+static VOID IrqOnStatus       (PBUS_TRANSACTION pTrans);
+static VOID IrqOnSendStatus   (PBUS_TRANSACTION pTrans);
+static VOID IrqOnSendClear    (PBUS_TRANSACTION pTrans);
+static VOID IrqOnSendFlush    (PBUS_TRANSACTION pTrans);
+static VOID IrqOnLoad         (PBUS_TRANSACTION pTrans);
+static VOID IrqRecv           ();
+#ifdef NRF24_IRQ_VECTOR
+static VOID IrqReadPacket     (UI8 cbPacket);
+static VOID IrqOnLength       (PBUS_TRANSACTION pTrans);
+static VOID IrqOnPacket       (PBUS_TRANSACTION pTrans);
+static VOID IrqOnFlush        (PBUS_TRANSACTION pTrans);
+#endif
 //-------------------[         Implementation          ]-------------------//
+//-----------< FUNCTION: CaptureStatus >-------------------------------------
+// Purpose:    caches a STATUS byte clocked out by the NRF24
+// Parameters: bStatus - the captured STATUS value
+//             fValid  - TRUE if the value reflects the current state
+//                       FALSE if the command has since changed it
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID CaptureStatus (BYTE bStatus, BOOL fValid)
+{
+   g_bStatus      = bStatus;
+   g_fStatusValid = fValid;
+   g_nStatusTime  = g_nStatusClock;
+}
 //-----------< FUNCTION: ReadRegister >--------------------------------------
 // Purpose:    reads an NRF24 register over SPI
 // Parameters: nRegister - register address
@@ -83,11 +204,16 @@ static BOOL g_fPowerMode   = NRF24_MODE_OFF;       // powered up?
 //---------------------------------------------------------------------------
 static PVOID ReadRegister (UI8 nRegister, PVOID pvData, UI8 cbData)
 {
-   UI8  cbSendRecv = cbData + 1;
-   BYTE pbSendRecv[cbSendRecv];
-   pbSendRecv[0] = COMMAND_READREGISTER | (nRegister & 0x1F);
-   SpiSendRecv(g_nSsPin, pbSendRecv, cbSendRecv, pbSendRecv, cbSendRecv);
-   memcpy(pvData, pbSendRecv + 1, cbData);
+   // capture the status byte and receive directly into the caller's buffer
+   BYTE bCommand = COMMAND_READREGISTER | (nRegister & 0x1F);
+   BYTE bStatus;
+   BUS_SEGMENT pSegments[] =
+   {
+      { .pbSend = &bCommand, .pbRecv = &bStatus, .cbData = 1 },
+      { .pbSend = NULL,      .pbRecv = pvData,   .cbData = cbData }
+   };
+   BusSendRecvV(&g_Bus, g_nSsPin, pSegments, 2);
+   CaptureStatus(bStatus, TRUE);
    return pvData;
 }
 //-----------< FUNCTION: WriteRegister >-------------------------------------
@@ -99,11 +225,15 @@ static PVOID ReadRegister (UI8 nRegister, PVOID pvData, UI8 cbData)
 //---------------------------------------------------------------------------
 static VOID WriteRegister (UI8 nRegister, PVOID pvData, UI8 cbData)
 {
-   UI8  cbSend = cbData + 1;
-   BYTE pbSend[cbSend];
-   pbSend[0] = COMMAND_WRITEREGISTER | (nRegister & 0x1F);
-   memcpy(pbSend + 1, pvData, cbData);
-   SpiSend(g_nSsPin, pbSend, cbSend);
+   BYTE bCommand = COMMAND_WRITEREGISTER | (nRegister & 0x1F);
+   BYTE bStatus;
+   BUS_SEGMENT pSegments[] =
+   {
+      { .pbSend = &bCommand, .pbRecv = &bStatus, .cbData = 1 },
+      { .pbSend = pvData,    .pbRecv = NULL,     .cbData = cbData }
+   };
+   BusSendRecvV(&g_Bus, g_nSsPin, pSegments, 2);
+   CaptureStatus(bStatus, TRUE);
 }
 //-----------< FUNCTION: ReadRegister8 >-------------------------------------
 // Purpose:    reads an 8-bit NRF24 register
@@ -114,7 +244,15 @@ static UI8 ReadRegister8 (UI8 nRegister)
 {
    BYTE pbSend[1] = { COMMAND_READREGISTER | (nRegister & 0x1F) };
    BYTE pbRecv[2];
-   SpiSendRecv(g_nSsPin, pbSend, sizeof(pbSend), pbRecv, sizeof(pbRecv));
+   BusSendRecv(
+      &g_Bus,
+      g_nSsPin,
+      pbSend,
+      sizeof(pbSend),
+      pbRecv,
+      sizeof(pbRecv)
+   );
+   CaptureStatus(pbRecv[0], TRUE);
    return pbRecv[1];
 }
 //-----------< FUNCTION: WriteRegister8 >------------------------------------
@@ -126,7 +264,22 @@ static UI8 ReadRegister8 (UI8 nRegister)
 static VOID WriteRegister8 (UI8 nRegister, UI8 nValue)
 {
    BYTE pbSend[2] = { COMMAND_WRITEREGISTER | (nRegister & 0x1F), nValue };
-   SpiSend(g_nSsPin, pbSend, sizeof(pbSend));
+   BYTE pbRecv[1];
+   BusSendRecv(&g_Bus, g_nSsPin, pbSend, sizeof(pbSend), pbRecv, 1);
+   CaptureStatus(pbRecv[0], TRUE);
+}
+//-----------< FUNCTION: WriteShadow8 >-------------------------------------
+// Purpose:    updates a shadowed 8-bit NRF24 register and writes it
+//             through to the transceiver
+// Parameters: nRegister - register address
+//             pbShadow  - the register's shadow copy
+//             bValue    - value to assign
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID WriteShadow8 (UI8 nRegister, PBYTE pbShadow, BYTE bValue)
+{
+   *pbShadow = bValue;
+   WriteRegister8(nRegister, bValue);
 }
 //-----------< FUNCTION: ReadStatus >----------------------------------------
 // Purpose:    reads the NRF24 status register
@@ -138,7 +291,8 @@ static VOID WriteRegister8 (UI8 nRegister, UI8 nValue)
 static UI8 ReadStatus ()
 {
    BYTE pbSendRecv[1] = { COMMAND_NOOP };
-   SpiSendRecv(g_nSsPin, pbSendRecv, 1, pbSendRecv, 1);
+   BusSendRecv(&g_Bus, g_nSsPin, pbSendRecv, 1, pbSendRecv, 1);
+   CaptureStatus(pbSendRecv[0], TRUE);
    return pbSendRecv[0];
 }
 //-----------< FUNCTION: ReadWriteStatus >-----------------------------------
@@ -149,7 +303,9 @@ static UI8 ReadStatus ()
 static UI8 ReadWriteStatus (UI8 fStatus)
 {
    BYTE pbSendRecv[2] = { COMMAND_WRITEREGISTER | REGISTER_STATUS, fStatus };
-   SpiSendRecv(g_nSsPin, pbSendRecv, 2, pbSendRecv, 1);
+   BusSendRecv(&g_Bus, g_nSsPin, pbSendRecv, 2, pbSendRecv, 1);
+   // the written IRQ bits are cleared after the previous value is returned
+   CaptureStatus(pbSendRecv[0] & ~(fStatus & NRF24_IRQ_ALL), TRUE);
    return pbSendRecv[0];
 }
 //-----------< FUNCTION: Nrf24Init >----------------------------------------
@@ -159,6 +315,9 @@ static UI8 ReadWriteStatus (UI8 fStatus)
 //---------------------------------------------------------------------------
 VOID Nrf24Init (PNRF24_CONFIG pConfig)
 {
+   // attach to the configured bus, or the SPI master by default
+   if (pConfig->Bus.pfnQueue != NULL)
+      g_Bus = pConfig->Bus;
    // initialize output pins
    g_nSsPin = pConfig->nSsPin;
    g_nCePin = pConfig->nCePin;
@@ -191,10 +350,46 @@ VOID Nrf24Init (PNRF24_CONFIG pConfig)
       Nrf24SetPayloadLength(i, 0);
    }
    Nrf24SetDynPayload(NRF24_PIPE_NONE);
+   Nrf24SetFeatures(0);
    // flush dynamic registers
    Nrf24ClearIrq(NRF24_IRQ_ALL);
    Nrf24FlushSend();
    Nrf24FlushRecv();
+   g_pfnOnIrq = pConfig->pfnOnIrq;
+#ifdef NRF24_IRQ_VECTOR
+   // enable the falling edge (INT0/INT1) or pin change interrupt on
+   // the active low IRQ pin
+   g_nIrqPin = pConfig->nIrqPin;
+   if (g_nIrqPin != PIN_INVALID)
+   {
+      PinSetInput(g_nIrqPin);
+      if (g_nIrqPin == PIN_INT0)
+      {
+         EICRA  = (EICRA & ~BitMask(ISC00)) | BitMask(ISC01);
+         EIMSK |= BitMask(INT0);
+      }
+      else if (g_nIrqPin == PIN_INT1)
+      {
+         EICRA  = (EICRA & ~BitMask(ISC10)) | BitMask(ISC11);
+         EIMSK |= BitMask(INT1);
+      }
+      else if (g_nIrqPin < 8)
+      {
+         PCICR  |= BitMask(PCIE0);
+         PCMSK0 |= BitMask(g_nIrqPin % 8);
+      }
+      else if (g_nIrqPin < 16)
+      {
+         PCICR  |= BitMask(PCIE1);
+         PCMSK1 |= BitMask(g_nIrqPin % 8);
+      }
+      else
+      {
+         PCICR  |= BitMask(PCIE2);
+         PCMSK2 |= BitMask(g_nIrqPin % 8);
+      }
+   }
+#endif
  }
 //-----------< FUNCTION: Nrf24GetIrqMask >-----------------------------------
 // Purpose:    gets the currently masked IRQs from the CONFIG register
@@ -203,7 +398,7 @@ VOID Nrf24Init (PNRF24_CONFIG pConfig)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetIrqMask ()
 {
-   return ReadRegister8(REGISTER_CONFIG) & NRF24_IRQ_ALL;
+   return g_bConfig & NRF24_IRQ_ALL;
 }
 //-----------< FUNCTION: Nrf24SetIrqMask >-----------------------------------
 // Purpose:    sets the currently masked IRQs in the CONFIG register
@@ -212,9 +407,10 @@ UI8 Nrf24GetIrqMask ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetIrqMask (UI8 fMask)
 {
-   WriteRegister8(
+   WriteShadow8(
       REGISTER_CONFIG,
-      (ReadRegister8(REGISTER_CONFIG) & ~NRF24_IRQ_ALL) | 
+      &g_bConfig,
+      (g_bConfig & ~NRF24_IRQ_ALL) | 
       (fMask & NRF24_IRQ_ALL)
    );
 }
@@ -225,7 +421,7 @@ VOID Nrf24SetIrqMask (UI8 fMask)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetCrc ()
 {
-   return ReadRegister8(REGISTER_CONFIG) & 0x0C;
+   return g_bConfig & 0x0C;
 }
 //-----------< FUNCTION: Nrf24SetCrc >---------------------------------------
 // Purpose:    sets the CRC mode in the CONFIG register
@@ -234,9 +430,10 @@ UI8 Nrf24GetCrc ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetCrc (UI8 fCrc)
 {
-   WriteRegister8(
+   WriteShadow8(
       REGISTER_CONFIG,
-      (ReadRegister8(REGISTER_CONFIG) & ~0x0C) | 
+      &g_bConfig,
+      (g_bConfig & ~0x0C) | 
       (fCrc & 0x0C)
    );
 }
@@ -247,7 +444,7 @@ VOID Nrf24SetCrc (UI8 fCrc)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetAutoAck ()
 {
-   return ReadRegister8(REGISTER_AUTOACK);
+   return g_bAutoAck;
 }
 //-----------< FUNCTION: Nrf24SetAutoAck >-----------------------------------
 // Purpose:    sets the EN_AA bitmask register
@@ -256,7 +453,7 @@ UI8 Nrf24GetAutoAck ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetAutoAck (UI8 fAutoAck)
 {
-   WriteRegister8(REGISTER_AUTOACK, fAutoAck & 0x3F);
+   WriteShadow8(REGISTER_AUTOACK, &g_bAutoAck, fAutoAck & 0x3F);
 }
 //-----------< FUNCTION: Nrf24GetRXEnabled >---------------------------------
 // Purpose:    gets the EN_RXADDR register
@@ -265,7 +462,7 @@ VOID Nrf24SetAutoAck (UI8 fAutoAck)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetRXEnabled ()
 {
-   return ReadRegister8(REGISTER_RXENABLED);
+   return g_bRXEnabled;
 }
 //-----------< FUNCTION: Nrf24SetRXEnabled >---------------------------------
 // Purpose:    sets the EN_RXADDR register
@@ -274,7 +471,7 @@ UI8 Nrf24GetRXEnabled ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetRXEnabled (UI8 fRXEnabled)
 {
-   WriteRegister8(REGISTER_RXENABLED, fRXEnabled & 0x3F);
+   WriteShadow8(REGISTER_RXENABLED, &g_bRXEnabled, fRXEnabled & 0x3F);
 }
 //-----------< FUNCTION: Nrf24GetAddressSize >-------------------------------
 // Purpose:    gets the SETUP_AW register
@@ -283,7 +480,7 @@ VOID Nrf24SetRXEnabled (UI8 fRXEnabled)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetAddressSize ()
 {
-   return ReadRegister8(REGISTER_ADDRESSWIDTH) + 2;
+   return g_cbAddress;
 }
 //-----------< FUNCTION: Nrf24SetAddressSize >-------------------------------
 // Purpose:    sets the SETUP_AW register
@@ -303,20 +500,21 @@ VOID Nrf24SetAddressSize (UI8 cbAddress)
 // Parameters: none
 // Returns:    retry delay, in microseconds
 //---------------------------------------------------------------------------
-UI8 Nrf24GetRetryDelay ()
+UI16 Nrf24GetRetryDelay ()
 {
-   return ((ReadRegister8(REGISTER_AUTORETRY) >> 4) + 1) * 250;
+   return ((UI16)(g_bAutoRetry >> 4) + 1) * 250;
 }
 //-----------< FUNCTION: Nrf24SetRetryDelay >--------------------------------
 // Purpose:    sets the retry delay in the SETUP_RETR register
 // Parameters: nDelay - retry delay, in microseconds
 // Returns:    none
 //---------------------------------------------------------------------------
-VOID Nrf24SetRetryDelay (UI8 nDelay)
+VOID Nrf24SetRetryDelay (UI16 nDelay)
 {
-   WriteRegister8(
+   WriteShadow8(
       REGISTER_AUTORETRY,
-      (ReadRegister8(REGISTER_AUTORETRY) & ~0xF0) | 
+      &g_bAutoRetry,
+      (g_bAutoRetry & ~0xF0) | 
       ((nDelay / 250 - 1) << 4)
    );
 }
@@ -327,7 +525,7 @@ VOID Nrf24SetRetryDelay (UI8 nDelay)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetRetryCount ()
 {
-   return ReadRegister8(REGISTER_AUTORETRY) & 0x0F;
+   return g_bAutoRetry & 0x0F;
 }
 //-----------< FUNCTION: Nrf24SetRetryCount >--------------------------------
 // Purpose:    sets the retry count in the SETUP_RETR register
@@ -336,9 +534,10 @@ UI8 Nrf24GetRetryCount ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetRetryCount (UI8 nCount)
 {
-   WriteRegister8(
+   WriteShadow8(
       REGISTER_AUTORETRY,
-      (ReadRegister8(REGISTER_AUTORETRY) & ~0x0F) | 
+      &g_bAutoRetry,
+      (g_bAutoRetry & ~0x0F) | 
       (nCount & 0x0F)
    );
 }
@@ -349,7 +548,7 @@ VOID Nrf24SetRetryCount (UI8 nCount)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetRFChannel ()
 {
-   return ReadRegister8(REGISTER_RFCHANNEL);
+   return g_bRFChannel;
 }
 //-----------< FUNCTION: Nrf24SetRFChannel >---------------------------------
 // Purpose:    sets the RF_CH register
@@ -359,7 +558,7 @@ UI8 Nrf24GetRFChannel ()
 VOID Nrf24SetRFChannel (UI8 nChannel)
 {
    if (nChannel < 84)
-      WriteRegister8(REGISTER_RFCHANNEL, nChannel);
+      WriteShadow8(REGISTER_RFCHANNEL, &g_bRFChannel, nChannel);
 }
 //-----------< FUNCTION: Nrf24GetRFDataRate >--------------------------------
 // Purpose:    gets the RF data rate from the RF_SETUP register
@@ -368,7 +567,7 @@ VOID Nrf24SetRFChannel (UI8 nChannel)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetRFDataRate ()
 {
-   return ReadRegister8(REGISTER_RFCONFIG) & 0x8;
+   return g_bRFConfig & 0x28;
 }
 //-----------< FUNCTION: Nrf24SetRFDataRate >--------------------------------
 // Purpose:    sets the RF data rate in the RF_SETUP register
@@ -377,9 +576,10 @@ UI8 Nrf24GetRFDataRate ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetRFDataRate (UI8 fDataRate)
 {
-   WriteRegister8(
+   WriteShadow8(
       REGISTER_RFCONFIG,
-      (ReadRegister8(REGISTER_RFCONFIG) & ~0x8) | fDataRate
+      &g_bRFConfig,
+      (g_bRFConfig & ~0x28) | (fDataRate & 0x28)
    );
 }
 //-----------< FUNCTION: Nrf24GetRFPower >-----------------------------------
@@ -389,7 +589,7 @@ VOID Nrf24SetRFDataRate (UI8 fDataRate)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetRFPower ()
 {
-   return (ReadRegister8(REGISTER_RFCONFIG) >> 2) & 0x3;
+   return (g_bRFConfig >> 1) & 0x3;
 }
 //-----------< FUNCTION: Nrf24SetRFPower >-----------------------------------
 // Purpose:    sets the RF power level in the RF_SETUP register
@@ -398,9 +598,10 @@ UI8 Nrf24GetRFPower ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetRFPower (UI8 fPower)
 {
-   WriteRegister8(
+   WriteShadow8(
       REGISTER_RFCONFIG,
-      (ReadRegister8(REGISTER_RFCONFIG) & ~0x6) |
+      &g_bRFConfig,
+      (g_bRFConfig & ~0x6) |
       ((fPower & 0x3) << 1)
    );
 }
@@ -411,7 +612,7 @@ VOID Nrf24SetRFPower (UI8 fPower)
 //---------------------------------------------------------------------------
 BOOL Nrf24GetLnaGain ()
 {
-   return ReadRegister8(REGISTER_RFCONFIG) & 0x1;
+   return g_bRFConfig & 0x1;
 }
 //-----------< FUNCTION: Nrf24SetLnaGain >-----------------------------------
 // Purpose:    sets the low noise amplifer bit in the RF_SETUP register
@@ -420,9 +621,10 @@ BOOL Nrf24GetLnaGain ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetLnaGain (BOOL bLnaGain)
 {
-   WriteRegister8(
+   WriteShadow8(
       REGISTER_RFCONFIG,
-      (ReadRegister8(REGISTER_RFCONFIG) & ~0x1) | 
+      &g_bRFConfig,
+      (g_bRFConfig & ~0x1) | 
       ((bLnaGain & 0x1) << 0)
    );
 }
@@ -447,6 +649,32 @@ UI8 Nrf24GetRXPipe ()
    UI8 fPipe = (ReadStatus() >> 1) & 0x7;
    return (fPipe != 0x7) ? fPipe : NRF24_PIPE_UNKNOWN;
 }
+//-----------< FUNCTION: Nrf24Tick >-----------------------------------------
+// Purpose:    advances the status clock used to age the STATUS cache
+//             this is typically called once per control loop iteration
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID Nrf24Tick ()
+{
+   g_nStatusClock++;
+   // expire the cache before its age wraps around
+   if ((UI8)(g_nStatusClock - g_nStatusTime) == 0xFF)
+      g_fStatusValid = FALSE;
+}
+//-----------< FUNCTION: Nrf24GetCachedStatus >------------------------------
+// Purpose:    gets the STATUS register captured from a recent command,
+//             reading it from the transceiver only if the cached value
+//             is invalid or too old
+// Parameters: nMaxAge - the maximum cache age, in Nrf24Tick calls
+// Returns:    the STATUS register value
+//---------------------------------------------------------------------------
+UI8 Nrf24GetCachedStatus (UI8 nMaxAge)
+{
+   if (g_fStatusValid && (UI8)(g_nStatusClock - g_nStatusTime) <= nMaxAge)
+      return g_bStatus;
+   return ReadStatus();
+}
 //-----------< FUNCTION: Nrf24GetLostPackets >-------------------------------
 // Purpose:    gets the lost packet count from the OBSERVE_TX register
 // Parameters: none
@@ -568,15 +796,16 @@ VOID Nrf24SetTXAddress (PCSTR pszAddress)
    }
 }
 //-----------< FUNCTION: Nrf24GetPayloadLength >-----------------------------
-// Purpose:    gets the payload length for an RX pipe from the
-//             RX_PW_P* registers
+// Purpose:    gets the static payload length configured for an RX pipe
+//             in the RX_PW_P* registers (not the length of a received
+//             dynamic payload)
 // Parameters: nPipe - the number of the pipe to query
-// Returns:    the expected or actual payload length for the pipe
+// Returns:    the configured static payload length for the pipe
 //---------------------------------------------------------------------------
 UI8 Nrf24GetPayloadLength (UI8 nPipe)
 {
    if (nPipe < NRF24_PIPE_COUNT)
-      return ReadRegister8(REGISTER_RXLENGTH0 + nPipe);
+      return g_pcbPayload[nPipe];
    return 0;
 }
 //-----------< FUNCTION: Nrf24SetPayloadLength >-----------------------------
@@ -589,7 +818,7 @@ UI8 Nrf24GetPayloadLength (UI8 nPipe)
 VOID Nrf24SetPayloadLength (UI8 nPipe, UI8 cbPayload)
 {
    if (nPipe < NRF24_PIPE_COUNT && cbPayload <= NRF24_PACKET_MAX)
-      WriteRegister8(REGISTER_RXLENGTH0 + nPipe, cbPayload);
+      WriteShadow8(REGISTER_RXLENGTH0 + nPipe, &g_pcbPayload[nPipe], cbPayload);
 }
 //-----------< FUNCTION: Nrf24GetFifoStatus >--------------------------------
 // Purpose:    gets the FIFO_STATUS register value
@@ -608,7 +837,7 @@ UI8 Nrf24GetFifoStatus ()
 //---------------------------------------------------------------------------
 UI8 Nrf24GetDynPayload ()
 {
-   return ReadRegister8(REGISTER_DYNPAYLOAD);
+   return g_bDynPayload;
 }
 //-----------< FUNCTION: Nrf24SetDynPayload >--------------------------------
 // Purpose:    gets the DYNPD register
@@ -617,7 +846,7 @@ UI8 Nrf24GetDynPayload ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetDynPayload (UI8 fDynPayload)
 {
-   WriteRegister8(REGISTER_DYNPAYLOAD, fDynPayload & 0x3F);
+   WriteShadow8(REGISTER_DYNPAYLOAD, &g_bDynPayload, fDynPayload & 0x3F);
 }
 //-----------< FUNCTION: Nrf24GetFeatures >----------------------------------
 // Purpose:    gets the contents of the FEATURE register
@@ -626,7 +855,7 @@ VOID Nrf24SetDynPayload (UI8 fDynPayload)
 //---------------------------------------------------------------------------
 UI8 Nrf24GetFeatures ()
 {
-   return ReadRegister8(REGISTER_FEATURE);
+   return g_bFeature;
 }
 //-----------< FUNCTION: Nrf24SetFeatures >----------------------------------
 // Purpose:    sets the contents of the FEATURE register
@@ -635,8 +864,7 @@ UI8 Nrf24GetFeatures ()
 //---------------------------------------------------------------------------
 VOID Nrf24SetFeatures (UI8 fFeatures)
 {
-   WriteRegister8(REGISTER_FEATURE, fFeatures & 0x7);
-   g_bTXRecvAck = !(fFeatures & NRF24_FEATURE_DISABLEACK);
+   WriteShadow8(REGISTER_FEATURE, &g_bFeature, fFeatures & 0x7);
 }
 //-----------< FUNCTION: Nrf24ClearIrq >-------------------------------------
 // Purpose:    clears interrupts currently set
@@ -654,7 +882,10 @@ UI8 Nrf24ClearIrq (UI8 fIrq)
 //---------------------------------------------------------------------------
 VOID Nrf24FlushSend ()
 {
-   SpiSend(g_nSsPin, (BYTE[]){ COMMAND_TXFLUSH }, 1);
+   BYTE pbSendRecv[1] = { COMMAND_TXFLUSH };
+   BusSendRecv(&g_Bus, g_nSsPin, pbSendRecv, 1, pbSendRecv, 1);
+   // the TX FIFO is no longer full
+   CaptureStatus(pbSendRecv[0] & ~0x01, TRUE);
 }
 //-----------< FUNCTION: Nrf24FlushRecv >------------------------------------
 // Purpose:    empties the transceiver's RX FIFO
@@ -663,7 +894,10 @@ VOID Nrf24FlushSend ()
 //---------------------------------------------------------------------------
 VOID Nrf24FlushRecv ()
 {
-   SpiSend(g_nSsPin, (BYTE[]){ COMMAND_RXFLUSH }, 1);
+   BYTE pbSendRecv[1] = { COMMAND_RXFLUSH };
+   BusSendRecv(&g_Bus, g_nSsPin, pbSendRecv, 1, pbSendRecv, 1);
+   // the RX FIFO is now empty
+   CaptureStatus(pbSendRecv[0] | 0x0E, TRUE);
 }
 //-----------< FUNCTION: Nrf24PowerOn >--------------------------------------
 // Purpose:    starts up the transceiver
@@ -690,9 +924,10 @@ VOID Nrf24PowerOn (UI8 fMode)
             break;
       }
       Nrf24ClearIrq(NRF24_IRQ_ALL);
-      WriteRegister8(
+      WriteShadow8(
          REGISTER_CONFIG,
-         (ReadRegister8(REGISTER_CONFIG) & ~0x3) | (0x2) | (fMode & 0x1)
+         &g_bConfig,
+         (g_bConfig & ~0x3) | (0x2) | (fMode & 0x1)
       );
       g_fPowerMode = fMode;
       // if receiving, set CE high to enable incoming packets
@@ -709,14 +944,16 @@ VOID Nrf24PowerOff ()
 {
    PinSetLo(g_nCePin);
    g_fPowerMode = NRF24_MODE_OFF;
-   WriteRegister8(
+   WriteShadow8(
       REGISTER_CONFIG,
-      ReadRegister8(REGISTER_CONFIG) & ~0x3
+      &g_bConfig,
+      g_bConfig & ~0x3
    );
 }
 //-----------< FUNCTION: Nrf24BeginSend >------------------------------------
 // Purpose:    transmits a data packet asynchronously
-// Parameters: pvPacket - packet to transfer
+// Parameters: pvPacket - packet to transfer, which must remain valid
+//                        until Nrf24EndSend
 //             cbPacket - number of bytes to transfer
 // Returns:    none
 //---------------------------------------------------------------------------
@@ -724,14 +961,17 @@ VOID Nrf24BeginSend (PCVOID pvPacket, BSIZE cbPacket)
 {
    if (g_fPowerMode == NRF24_MODE_SEND)
    {
-      // ensure no other transfers are in progress
-      SpiWait();
+      // ensure the previous packet transfer is complete
+      BusTransWait(&g_PacketTrans);
       // clock in the command and data buffer
-      UI8  cbSend = cbPacket + 1;
-      BYTE pbSend[cbSend];
-      pbSend[0] = g_bTXRecvAck ? COMMAND_TXWRITEPACKET : COMMAND_TXWRITENOACK;
-      memcpy(pbSend + 1, pvPacket, Min(cbPacket, NRF24_PACKET_MAX));
-      SpiSend(g_nSsPin, pbSend, cbSend);
+      g_bPacketCommand = !(g_bFeature & NRF24_FEATURE_DISABLEACK) ?
+         COMMAND_TXWRITEPACKET : 
+         COMMAND_TXWRITENOACK;
+      g_pPacketSegments[1].pbSend = pvPacket;
+      g_pPacketSegments[1].pbRecv = NULL;
+      g_pPacketSegments[1].cbData = Min(cbPacket, NRF24_PACKET_MAX);
+      g_PacketTrans.nAddress = g_nSsPin;
+      BusQueue(&g_Bus, &g_PacketTrans);
       // set CE high to take the transceiver out of standby
       PinSetHi(g_nCePin);
    }
@@ -745,50 +985,510 @@ VOID Nrf24EndSend ()
 {
    if (g_fPowerMode == NRF24_MODE_SEND)
    {
-      SpiWait();
+      BusTransWait(&g_PacketTrans);
+      // the TX FIFO may have filled after the status byte was clocked out
+      CaptureStatus(g_bPacketStatus, FALSE);
       // set CE low to return to standby after the transfer
       PinSetLo(g_nCePin);
    }
 }
+//-----------< FUNCTION: Nrf24SetAckPayload >--------------------------------
+// Purpose:    loads a payload to return with the next acknowledgement
+//             sent on a receive pipe
+//             . requires NRF24_FEATURE_ACKPAYLOAD, and dynamic payloads
+//               and auto-ack on the pipe (at both ends of the link)
+//             . payloads share the TX FIFO, which holds up to
+//               NRF24_TX_FIFO_DEPTH of them, and are sent in order
+//             . the sender's retry delay must cover the ACK payload, or
+//               it times out before the ACK arrives; at 2 Mbps, 250 us
+//               allows up to 15 bytes and 500 us the full 32, and lower
+//               data rates need longer delays (see the datasheet's ARD
+//               table)
+// Parameters: nPipe    - the receive pipe to acknowledge
+//             pvPacket - the payload to return
+//             cbPacket - number of bytes to return
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID Nrf24SetAckPayload (UI8 nPipe, PCVOID pvPacket, BSIZE cbPacket)
+{
+   BYTE bCommand = COMMAND_ACKWRITEPACKET | (nPipe & 0x7);
+   BYTE bStatus;
+   UI8  cbData   = Min(cbPacket, NRF24_PACKET_MAX);
+   BUS_SEGMENT pSegments[] =
+   {
+      { .pbSend = &bCommand, .pbRecv = &bStatus, .cbData = 1 },
+      { .pbSend = pvPacket,  .pbRecv = NULL,     .cbData = cbData }
+   };
+   BusSendRecvV(&g_Bus, g_nSsPin, pSegments, 2);
+   // the TX FIFO may have filled after the status byte was clocked out
+   CaptureStatus(bStatus, FALSE);
+}
 //-----------< FUNCTION: Nrf24BeginRecv >------------------------------------
 // Purpose:    begins an async packet receive operation
-// Parameters: cbPacket - number of bytes to receive
+//             in send mode, this receives the payloads of acknowledgements
+// Parameters: pvPacket - receive the packet directly into here, which must
+//                        remain valid until Nrf24EndRecv
+//             cbPacket - number of bytes to receive
 // Returns:    none
 //---------------------------------------------------------------------------
-VOID Nrf24BeginRecv (BSIZE cbPacket)
+VOID Nrf24BeginRecv (PVOID pvPacket, BSIZE cbPacket)
 {
-   if (g_fPowerMode == NRF24_MODE_RECV)
+   if (g_fPowerMode != NRF24_MODE_OFF)
    {
-      // ensure no other transfers are in progress
-      SpiWait();
-      // clock in the command buffer
-      UI8  cbSend   = 1;
-      BYTE pbSend[] = { COMMAND_RXREADPACKET };
-      SpiBeginSendRecv(
-         g_nSsPin, 
-         pbSend, 
-         cbSend, 
-         Min(cbPacket, NRF24_PACKET_MAX) + 1, 
-         NULL
-      );
+      // ensure the previous packet transfer is complete
+      BusTransWait(&g_PacketTrans);
+      g_pPacketSegments[1].pbSend = NULL;
+      g_pPacketSegments[1].pbRecv = pvPacket;
+      g_pPacketSegments[1].cbData = Min(cbPacket, NRF24_PACKET_MAX);
+#ifdef NRF24_IRQ_VECTOR
+      // the IRQ handler has already received the packet, if any
+      if (g_nIrqPin != PIN_INVALID)
+         return;
+#endif
+      // clock in the command, then the packet
+      g_bPacketCommand = COMMAND_RXREADPACKET;
+      g_PacketTrans.nAddress = g_nSsPin;
+      BusQueue(&g_Bus, &g_PacketTrans);
    }
 }
 //-----------< FUNCTION: Nrf24EndRecv >--------------------------------------
 // Purpose:    completes an async packet receive operation
-// Parameters: pvPacket - return the packet via here
-//             cbPacket - number of bytes to receive
-// Returns:    pvPacket if a packet was received
+// Parameters: none
+// Returns:    the Nrf24BeginRecv packet buffer if a packet was received
 //             NULL otherwise
 //---------------------------------------------------------------------------
-PVOID Nrf24EndRecv (PVOID pvPacket, BSIZE cbPacket)
+PVOID Nrf24EndRecv ()
 {
-   if (g_fPowerMode == NRF24_MODE_RECV)
+   if (g_fPowerMode != NRF24_MODE_OFF)
    {
-      UI8  cbRecv = Min(cbPacket, NRF24_PACKET_MAX) + 1;
-      BYTE pbRecv[cbRecv];
-      SpiEndSendRecv(pbRecv, cbRecv);
-      memcpy(pvPacket, pbRecv + 1, cbPacket);
-      return pvPacket;
+#ifdef NRF24_IRQ_VECTOR
+      if (g_nIrqPin != PIN_INVALID)
+      {
+         // copy the next packet out of the ring, if any
+         if (g_nRecvHead == g_nRecvTail)
+            return NULL;
+         PNRF24_SLOT pSlot = &g_pRecvSlots[g_nRecvTail & (NRF24_RECV_SLOTS - 1)];
+         memcpy(
+            g_pPacketSegments[1].pbRecv, 
+            pSlot->pbPacket, 
+            Min(g_pPacketSegments[1].cbData, pSlot->cbPacket)
+         );
+         // finish reading the slot before releasing it to the IRQ handler
+         MemoryBarrier();
+         g_nRecvTail++;
+         // restart an IRQ chain that stopped on a full ring
+         ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+         {
+            if (g_fRecvStalled)
+            {
+               g_fRecvStalled = FALSE;
+               IrqStart();
+            }
+         }
+         return g_pPacketSegments[1].pbRecv;
+      }
+#endif
+      BusTransWait(&g_PacketTrans);
+      // the status byte was clocked out before the packet was popped, so
+      // its RX pipe number reports whether the RX FIFO held a packet
+      // . the cache is invalidated, since the FIFO may now be empty
+      CaptureStatus(g_bPacketStatus, FALSE);
+      if (((g_bPacketStatus >> 1) & 0x7) != 0x7)
+         return g_pPacketSegments[1].pbRecv;
    }
    return NULL;
 }
+//-----------< FUNCTION: Nrf24QueueSend >------------------------------------
+// Purpose:    queues a packet for transmission, loading it into the TX
+//             FIFO as soon as there is room
+//             the transceiver must be powered on in send mode
+// Parameters: pPacket - the packet to send, which must remain valid (and
+//                       must not be queued again) until it completes
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID Nrf24QueueSend (PNRF24_PACKET pPacket)
+{
+   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+   {
+      pPacket->pNext   = NULL;
+      pPacket->nStatus = NRF24_SEND_BUSY;
+      if (g_pSendTail == NULL)
+         g_pSendHead = pPacket;
+      else
+         g_pSendTail->pNext = pPacket;
+      g_pSendTail = pPacket;
+      if (g_pSendNext == NULL)
+         g_pSendNext = pPacket;
+      IrqStart();
+   }
+}
+//-----------< FUNCTION: Nrf24IsSendQueueBusy >------------------------------
+// Purpose:    checks whether any queued packets have not yet completed
+// Parameters: none
+// Returns:    TRUE if packets are queued or in flight
+//             FALSE otherwise
+//---------------------------------------------------------------------------
+BOOL Nrf24IsSendQueueBusy ()
+{
+   return g_pSendHead != NULL;
+}
+//-----------< FUNCTION: Nrf24Poll >-----------------------------------------
+// Purpose:    services the transceiver's IRQs without the IRQ pin,
+//             completing sent packets and loading queued ones
+//             this is unnecessary if the IRQ pin is configured
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID Nrf24Poll ()
+{
+   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+      IrqStart();
+}
+//-----------< FUNCTION: IrqStart >------------------------------------------
+// Purpose:    starts the IRQ transaction chain, or flags it to run again
+//             if it is already running
+//             this must be called with interrupts disabled
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqStart ()
+{
+   if (g_fIrqActive)
+      g_fIrqPending = TRUE;
+   else
+   {
+      g_fIrqActive = TRUE;
+      g_fIrqFlags  = NRF24_IRQ_NONE;
+      IrqClearStatus();
+   }
+}
+//-----------< FUNCTION: IrqEnd >--------------------------------------------
+// Purpose:    completes the IRQ transaction chain, raising the callback
+//             for the IRQs handled, and restarts it if another IRQ was
+//             signalled while it was running
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqEnd ()
+{
+   g_fIrqActive = FALSE;
+   if (g_fIrqFlags != NRF24_IRQ_NONE && g_pfnOnIrq != NULL)
+      g_pfnOnIrq(g_fIrqFlags);
+   if (g_fIrqPending)
+   {
+      g_fIrqPending = FALSE;
+      IrqStart();
+   }
+}
+//-----------< FUNCTION: IrqQueue >------------------------------------------
+// Purpose:    queues the next transaction in the IRQ chain
+// Parameters: cbCommand     - number of g_pbIrqCommand bytes to send
+//             cbStatus      - number of g_pbIrqStatus bytes to receive
+//             pfnOnComplete - the next step in the chain
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqQueue (UI8 cbCommand, UI8 cbStatus, BUS_CALLBACK pfnOnComplete)
+{
+   g_IrqTrans.nAddress      = g_nSsPin;
+   g_IrqTrans.pbSend        = g_pbIrqCommand;
+   g_IrqTrans.cbSend        = cbCommand;
+   g_IrqTrans.pbRecv        = g_pbIrqStatus;
+   g_IrqTrans.cbRecv        = cbStatus;
+   g_IrqTrans.cSegments     = 0;
+   g_IrqTrans.pfnOnComplete = pfnOnComplete;
+   BusQueue(&g_Bus, &g_IrqTrans);
+}
+//-----------< FUNCTION: IrqQueuePacket >------------------------------------
+// Purpose:    queues a packet command in the IRQ chain
+// Parameters: bCommand      - the packet command
+//             pbSend        - packet to send (or NULL)
+//             pbRecv        - packet to receive (or NULL)
+//             cbPacket      - packet length
+//             pfnOnComplete - the next step in the chain
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqQueuePacket (
+   BYTE         bCommand,
+   PCBYTE       pbSend,
+   PBYTE        pbRecv,
+   UI8          cbPacket,
+   BUS_CALLBACK pfnOnComplete)
+{
+   g_pbIrqCommand[0] = bCommand;
+   g_pIrqSegments[0] = (BUS_SEGMENT)
+      { .pbSend = g_pbIrqCommand, .pbRecv = NULL, .cbData = 1 };
+   g_pIrqSegments[1] = (BUS_SEGMENT)
+      { .pbSend = pbSend, .pbRecv = pbRecv, .cbData = cbPacket };
+   g_IrqTrans.nAddress      = g_nSsPin;
+   g_IrqTrans.pSegments     = g_pIrqSegments;
+   g_IrqTrans.cSegments     = 2;
+   g_IrqTrans.pfnOnComplete = pfnOnComplete;
+   BusQueue(&g_Bus, &g_IrqTrans);
+}
+//-----------< FUNCTION: IrqClearStatus >------------------------------------
+// Purpose:    clears the IRQs in the STATUS register, which releases the
+//             IRQ pin, and captures the previous STATUS value
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqClearStatus ()
+{
+   g_pbIrqCommand[0] = COMMAND_WRITEREGISTER | REGISTER_STATUS;
+   g_pbIrqCommand[1] = NRF24_IRQ_ALL;
+   IrqQueue(2, 1, IrqOnStatus);
+}
+//-----------< FUNCTION: IrqOnStatus >---------------------------------------
+// Purpose:    IRQ chain STATUS completion callback
+//             services sent packets first, then received packets, and
+//             then loads the TX FIFO
+// Parameters: pTrans - the completed transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqOnStatus (PBUS_TRANSACTION pTrans)
+{
+   IgnoreParam(pTrans);
+   BYTE bStatus = g_pbIrqStatus[0];
+   g_fIrqFlags |= bStatus & NRF24_IRQ_ALL;
+   g_fSendIrq   = bStatus & (NRF24_IRQ_TX_DS | NRF24_IRQ_MAX_RT);
+   if (g_cSendInFlight != 0 && g_fSendIrq != NRF24_IRQ_NONE)
+   {
+      // read FIFO_STATUS to determine how many packets have been sent
+      g_pbIrqCommand[0] = COMMAND_READREGISTER | REGISTER_FIFOSTATUS;
+      IrqQueue(1, 2, IrqOnSendStatus);
+   }
+   else
+      IrqRecv();
+}
+//-----------< FUNCTION: IrqSendComplete >-----------------------------------
+// Purpose:    completes the oldest packet in flight
+// Parameters: nStatus - the packet status (NRF24_SEND_*)
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqSendComplete (UI8 nStatus)
+{
+   PNRF24_PACKET pPacket = g_pSendHead;
+   if ((g_pSendHead = pPacket->pNext) == NULL)
+      g_pSendTail = NULL;
+   g_cSendInFlight--;
+   pPacket->nStatus = nStatus;
+   if (pPacket->pfnOnComplete != NULL)
+      pPacket->pfnOnComplete(pPacket);
+}
+//-----------< FUNCTION: IrqOnSendStatus >-----------------------------------
+// Purpose:    IRQ chain FIFO_STATUS completion callback
+//             completes the packets that have left the TX FIFO
+//             . TX_DS is a single flag, so with packets remaining in the
+//               FIFO, one completion per TX_DS is assumed; this is exact
+//               as long as the chain runs once per packet (IRQ pin, or
+//               frequent polling), and an empty FIFO always completes
+//               every packet in flight
+//             . packets that finish between the STATUS clear and the
+//               FIFO_STATUS read set TX_DS again, but an empty FIFO has
+//               already completed them, so TX_DS is cleared once more
+//               before loading the FIFO, or the next chain run would
+//               complete a packet that is still in the FIFO
+//             . on MAX_RT, the packet at the front of the TX FIFO failed
+// Parameters: pTrans - the completed transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqOnSendStatus (PBUS_TRANSACTION pTrans)
+{
+   IgnoreParam(pTrans);
+   BYTE bFifo = g_pbIrqStatus[1];
+   if (bFifo & NRF24_FIFO_TX_EMPTY)
+   {
+      while (g_cSendInFlight != 0)
+         IrqSendComplete(NRF24_SEND_OK);
+      g_pbIrqCommand[0] = COMMAND_WRITEREGISTER | REGISTER_STATUS;
+      g_pbIrqCommand[1] = NRF24_IRQ_TX_DS;
+      IrqQueue(2, 1, IrqOnSendClear);
+      return;
+   }
+   if (g_fSendIrq & NRF24_IRQ_TX_DS)
+      IrqSendComplete(NRF24_SEND_OK);
+   if ((g_fSendIrq & NRF24_IRQ_MAX_RT) && g_cSendInFlight != 0)
+   {
+      // the failed packet blocks the TX FIFO, so discard the FIFO and
+      // reload the packets behind it
+      g_pbIrqCommand[0] = COMMAND_TXFLUSH;
+      IrqQueue(1, 0, IrqOnSendFlush);
+   }
+   else
+      IrqRecv();
+}
+//-----------< FUNCTION: IrqOnSendClear >------------------------------------
+// Purpose:    IRQ chain TX_DS clear completion callback
+// Parameters: pTrans - the completed transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqOnSendClear (PBUS_TRANSACTION pTrans)
+{
+   IgnoreParam(pTrans);
+   IrqRecv();
+}
+//-----------< FUNCTION: IrqOnSendFlush >------------------------------------
+// Purpose:    IRQ chain TX flush completion callback
+// Parameters: pTrans - the completed transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqOnSendFlush (PBUS_TRANSACTION pTrans)
+{
+   IgnoreParam(pTrans);
+   IrqSendComplete(NRF24_SEND_FAILED);
+   g_pSendNext     = g_pSendHead;
+   g_cSendInFlight = 0;
+   IrqRecv();
+}
+//-----------< FUNCTION: IrqLoad >-------------------------------------------
+// Purpose:    loads the next queued packet into the TX FIFO, if there is
+//             room, or completes the IRQ chain
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqLoad ()
+{
+   PNRF24_PACKET pPacket = g_pSendNext;
+   if (g_fPowerMode == NRF24_MODE_SEND && 
+       pPacket != NULL && 
+       g_cSendInFlight < NRF24_TX_FIFO_DEPTH)
+   {
+      IrqQueuePacket(
+         !(g_bFeature & NRF24_FEATURE_DISABLEACK) ?
+            COMMAND_TXWRITEPACKET : 
+            COMMAND_TXWRITENOACK,
+         pPacket->pvData,
+         NULL,
+         Min(pPacket->cbData, NRF24_PACKET_MAX),
+         IrqOnLoad
+      );
+   }
+   else
+   {
+      // return to standby once all packets have been sent
+      if (g_cSendInFlight == 0 && g_pSendHead == NULL && 
+          g_fPowerMode == NRF24_MODE_SEND)
+         PinSetLo(g_nCePin);
+      IrqEnd();
+   }
+}
+//-----------< FUNCTION: IrqOnLoad >-----------------------------------------
+// Purpose:    IRQ chain TX packet completion callback
+// Parameters: pTrans - the completed transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqOnLoad (PBUS_TRANSACTION pTrans)
+{
+   IgnoreParam(pTrans);
+   g_pSendNext = g_pSendNext->pNext;
+   g_cSendInFlight++;
+   // hold CE high, so that the transceiver sends back to back
+   PinSetHi(g_nCePin);
+   IrqLoad();
+}
+//-----------< FUNCTION: IrqRecv >-------------------------------------------
+// Purpose:    starts reading the next packet in the RX FIFO, if the IRQ 
+//             pin is configured, or else continues to load the TX FIFO
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqRecv ()
+{
+#ifdef NRF24_IRQ_VECTOR
+   UI8 nPipe = (g_pbIrqStatus[0] >> 1) & 0x7;
+   if (g_nIrqPin != PIN_INVALID && nPipe < NRF24_PIPE_COUNT)
+   {
+      if ((UI8)(g_nRecvHead - g_nRecvTail) >= NRF24_RECV_SLOTS)
+         g_fRecvStalled = TRUE;                 // ring full
+      else
+      {
+         g_pRecvSlots[g_nRecvHead & (NRF24_RECV_SLOTS - 1)].nPipe = nPipe;
+         if ((g_bFeature & NRF24_FEATURE_DYNPAYLOAD) && 
+             (g_bDynPayload & BitMask(nPipe)))
+         {
+            // read the dynamic payload length first
+            g_pbIrqCommand[0] = COMMAND_RXREADLENGTH;
+            IrqQueue(1, 2, IrqOnLength);
+         }
+         else
+            IrqReadPacket(g_pcbPayload[nPipe]);
+         return;
+      }
+   }
+#endif
+   IrqLoad();
+}
+#ifdef NRF24_IRQ_VECTOR
+//-----------< FUNCTION: IrqReadPacket >-------------------------------------
+// Purpose:    reads the packet at the front of the RX FIFO into the 
+//             ring slot at the head
+// Parameters: cbPacket - the packet length
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqReadPacket (UI8 cbPacket)
+{
+   if (cbPacket == 0 || cbPacket > NRF24_PACKET_MAX)
+   {
+      // the packet length is invalid, so discard the RX FIFO
+      g_pbIrqCommand[0] = COMMAND_RXFLUSH;
+      IrqQueue(1, 0, IrqOnFlush);
+   }
+   else
+   {
+      PNRF24_SLOT pSlot = &g_pRecvSlots[g_nRecvHead & (NRF24_RECV_SLOTS - 1)];
+      pSlot->cbPacket = cbPacket;
+      IrqQueuePacket(
+         COMMAND_RXREADPACKET,
+         NULL,
+         pSlot->pbPacket,
+         cbPacket,
+         IrqOnPacket
+      );
+   }
+}
+//-----------< FUNCTION: IrqOnLength >---------------------------------------
+// Purpose:    IRQ chain payload length completion callback
+// Parameters: pTrans - the completed transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqOnLength (PBUS_TRANSACTION pTrans)
+{
+   IgnoreParam(pTrans);
+   IrqReadPacket(g_pbIrqStatus[1]);
+}
+//-----------< FUNCTION: IrqOnPacket >---------------------------------------
+// Purpose:    IRQ chain RX packet completion callback
+//             publishes the packet and checks the RX FIFO for another
+// Parameters: pTrans - the completed transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqOnPacket (PBUS_TRANSACTION pTrans)
+{
+   IgnoreParam(pTrans);
+   // finish writing the slot before publishing it to Nrf24EndRecv
+   MemoryBarrier();
+   g_nRecvHead++;
+   IrqClearStatus();
+}
+//-----------< FUNCTION: IrqOnFlush >----------------------------------------
+// Purpose:    IRQ chain RX flush completion callback
+// Parameters: pTrans - the completed transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID IrqOnFlush (PBUS_TRANSACTION pTrans)
+{
+   IgnoreParam(pTrans);
+   IrqClearStatus();
+}
+//-----------< INTERRUPT: NRF24_IRQ_VECTOR >---------------------------------
+// Purpose:    responds to the NRF24 IRQ pin
+//             the pin is active low, and pin change interrupts also fire
+//             when it is released
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+ISR(NRF24_IRQ_VECTOR)
+{
+   if (g_nIrqPin != PIN_INVALID && !PinRead(g_nIrqPin))
+      IrqStart();
+}
+#endif
@@ -26,15 +26,52 @@
 #ifndef __AVRDEFS_H
 #include "avrdefs.h"
 #endif
+#ifndef __BUS_H
+#include "bus.h"
+#endif
 //-------------------[       Module Definitions        ]-------------------//
 //===========================================================================
+// NRF24 CONFIGURATION
+// . NRF24_IRQ_VECTOR         interrupt vector for the IRQ pin (INT0_vect,
+//                            INT1_vect or PCINTn_vect, matching nIrqPin),
+//                            or undefined to poll the transceiver
+// . NRF24_RECV_SLOTS         number of packets buffered by the IRQ handler
+//                            (a power of 2, 34 bytes each)
+//===========================================================================
+#ifndef NRF24_RECV_SLOTS
+#  define NRF24_RECV_SLOTS    (4)
+#endif
+//===========================================================================
 // NRF24 STRUCTURES
 //===========================================================================
+// IRQ callback, called from interrupt context with the IRQs handled
+typedef VOID (*NRF24_CALLBACK) (UI8 fIrq);
+// send queue packet
+// . a caller-owned descriptor for a packet queued by Nrf24QueueSend,
+//   which must remain valid until it completes; on completion, nStatus
+//   holds the result and the completion callback is called from 
+//   interrupt context, where the packet may be queued again
+typedef struct tagNrf24Packet NRF24_PACKET, *PNRF24_PACKET;
+typedef VOID (*NRF24_SEND_CALLBACK) (PNRF24_PACKET pPacket);
+struct tagNrf24Packet
+{
+   PNRF24_PACKET        pNext;            // queue link, owned by the driver
+   volatile UI8         nStatus;          // packet status (NRF24_SEND_*)
+   PCVOID               pvData;           // packet data
+   UI8                  cbData;           // packet length
+   NRF24_SEND_CALLBACK  pfnOnComplete;    // completion callback (optional)
+   PVOID                pvContext;        // callback context
+};
 // module configuration
 typedef struct tagNrf24Config
 {
    UI8   nSsPin;                          // SPI slave select pin
    UI8   nCePin;                          // NRF24 chip enable, activates RX/TX
+   BUS   Bus;                             // SPI bus interface (e.g. USPI_BUS),
+                                          // or zero for the SPI master
+   UI8   nIrqPin;                         // NRF24 IRQ pin (or PIN_INVALID),
+                                          // used with NRF24_IRQ_VECTOR
+   NRF24_CALLBACK pfnOnIrq;               // IRQ callback (optional)
 } NRF24_CONFIG, *PNRF24_CONFIG;
 //===========================================================================
 // NRF24 CONFIGURATION VALUES
@@ -56,6 +93,11 @@ typedef struct tagNrf24Config
 #define NRF24_PIPE5              0x05     // receive pipe #5
 // buffer parameters
 #define NRF24_PACKET_MAX         32       // maximum send/receive length
+#define NRF24_TX_FIFO_DEPTH      3        // TX FIFO capacity, in packets
+// send queue packet status
+#define NRF24_SEND_OK            0x00     // packet sent (and acknowledged)
+#define NRF24_SEND_BUSY          0x01     // queued or in flight
+#define NRF24_SEND_FAILED        0x02     // maximum retries exceeded
 // interrupts
 #define NRF24_IRQ_NONE           0x00     // for initialization
 #define NRF24_IRQ_RX_DR          0x40     // RX data ready interrupt
@@ -67,6 +109,7 @@ typedef struct tagNrf24Config
 #define NRF24_CRC_8BIT           0x08     // 1 byte CRC
 #define NRF24_CRC_16BIT          0x0C     // 2 byte CRC
 // RF data rates
+#define NRF24_RATE_250KBPS       0x20     // 250 kbps data rate
 #define NRF24_RATE_1MBPS         0x00     // 1 mbps data rate
 #define NRF24_RATE_2MBPS         0x08     // 2 mbps data rate
 // RF power modes
@@ -106,8 +149,8 @@ VOID     Nrf24SetRXEnabled       (UI8 fRXEnabled);
 UI8      Nrf24GetAddressSize     ();
 VOID     Nrf24SetAddressSize     (UI8 cbAddress);
 // SETUP_RETR register  
-UI8      Nrf24GetRetryDelay      ();
-VOID     Nrf24SetRetryDelay      (UI8 nDelay);
+UI16     Nrf24GetRetryDelay      ();
+VOID     Nrf24SetRetryDelay      (UI16 nDelay);
 UI8      Nrf24GetRetryCount      ();
 VOID     Nrf24SetRetryCount      (UI8 nCount);
 // RF_CH register 
@@ -123,6 +166,18 @@ VOID     Nrf24SetLnaGain         (BOOL bLnaGain);
 // STATUS register   
 UI8      Nrf24GetIrq             ();
 UI8      Nrf24GetRXPipe          ();
+// STATUS cache
+// . answers from the STATUS byte captured from a recent command, which
+//   does not reflect packets or acks that arrived after the capture
+VOID     Nrf24Tick               ();
+UI8      Nrf24GetCachedStatus    (UI8 nMaxAge);
+inline UI8 Nrf24GetCachedRXPipe (UI8 nMaxAge)
+   { UI8 fPipe = (Nrf24GetCachedStatus(nMaxAge) >> 1) & 0x7;
+     return (fPipe != 0x7) ? fPipe : NRF24_PIPE_UNKNOWN; }
+inline BOOL Nrf24IsRecvReady (UI8 nMaxAge)
+   { return Nrf24GetCachedRXPipe(nMaxAge) != NRF24_PIPE_UNKNOWN; }
+inline BOOL Nrf24IsSendFull (UI8 nMaxAge)
+   { return (Nrf24GetCachedStatus(nMaxAge) & 0x01) ? TRUE : FALSE; }
 // OBSERVE_TX register  
 UI8      Nrf24GetLostPackets     ();
 UI8      Nrf24GetRetransmits     ();
@@ -187,8 +242,19 @@ VOID     Nrf24PowerOn            (UI8 fMode);
 VOID     Nrf24PowerOff           ();
 VOID     Nrf24BeginSend          (PCVOID pvPacket, BSIZE cbPacket);
 VOID     Nrf24EndSend            ();
-VOID     Nrf24BeginRecv          (BSIZE cbPacket);
-PVOID    Nrf24EndRecv            (PVOID pvPacket, BSIZE cbPacket);
+VOID     Nrf24BeginRecv          (PVOID pvPacket, BSIZE cbPacket);
+PVOID    Nrf24EndRecv            ();
+VOID     Nrf24SetAckPayload      (UI8 nPipe, PCVOID pvPacket, BSIZE cbPacket);
+// send queue
+// . keeps the TX FIFO full with CE held high, so that packets are sent
+//   back to back; not to be mixed with Nrf24BeginSend/Nrf24EndSend
+VOID     Nrf24QueueSend          (PNRF24_PACKET pPacket);
+BOOL     Nrf24IsSendQueueBusy    ();
+VOID     Nrf24Poll               ();
+inline BOOL Nrf24PacketIsBusy (PNRF24_PACKET pPacket)
+   { return pPacket->nStatus == NRF24_SEND_BUSY; }
+inline UI8 Nrf24PacketWait (PNRF24_PACKET pPacket)
+   { while (Nrf24PacketIsBusy(pPacket)) Nrf24Poll(); return pPacket->nStatus; }
 // busy polling helpers
 inline BOOL Nrf24IsSendBusy ()
    { return (Nrf24GetFifoStatus() & NRF24_FIFO_TX_FULL) ? TRUE : FALSE; }
@@ -201,6 +267,6 @@ inline VOID Nrf24RecvWait ()
 // send/receive sync helpers
 inline VOID Nrf24Send (PCVOID pvPacket, BSIZE cbPacket)
    { Nrf24BeginSend(pvPacket, cbPacket); Nrf24EndSend(); }
-inline VOID Nrf24Recv (PVOID pvPacket, BSIZE cbPacket)
-   { Nrf24BeginRecv(cbPacket); Nrf24EndRecv(pvPacket, cbPacket); }
+inline PVOID Nrf24Recv (PVOID pvPacket, BSIZE cbPacket)
+   { Nrf24BeginRecv(pvPacket, cbPacket); return Nrf24EndRecv(); }
 #endif // __NRF24_H  
@@ -22,6 +22,9 @@
 //-------------------[      Library Include Files      ]-------------------//
 //-------------------[      Project Include Files      ]-------------------//
 #include "shiftreg.h"
+#if SHIFTREG_USPI
+#include "uspimast.h"
+#endif
 //-------------------[       Module Definitions        ]-------------------//
 //-------------------[        Module Variables         ]-------------------//
 //-------------------[        Module Prototypes        ]-------------------//
@@ -30,6 +33,11 @@ static UI8  g_nClockPin = PIN_INVALID;          // shift register clock output (
 static UI8  g_nLatchPin = PIN_INVALID;          // storage register clock output (STCP)
 static UI8  g_nDataPin  = PIN_INVALID;          // serial data output (DS)
 static BYTE g_pbBuffer[SHIFTREG_SIZE] = { 0, }; // shift register buffer
+#if SHIFTREG_USPI
+static BUS_SEGMENT g_pSegments[SHIFTREG_SIZE];  // buffer bytes, last first
+static BUS_TRANSACTION g_Trans;                 // register write transaction
+static volatile BOOL g_fDirty = FALSE;          // rewrite after g_Trans?
+#endif
 //-----------< FUNCTION: WriteRegister >-------------------------------------
 // Purpose:    writes the current buffer to the shift register
 // Parameters: none
@@ -37,6 +45,17 @@ static BYTE g_pbBuffer[SHIFTREG_SIZE] = { 0, }; // shift register buffer
 //---------------------------------------------------------------------------
 static VOID WriteRegister ()
 {
+#if SHIFTREG_USPI
+   // queue the register write, or if one is already in progress,
+   // have its completion callback queue another for the new contents
+   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+   {
+      if (BusTransIsBusy(&g_Trans))
+         g_fDirty = TRUE;
+      else
+         USpiQueue(&g_Trans);
+   }
+#else
    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
    {
       // serialize access to the shift register
@@ -56,7 +75,23 @@ static VOID WriteRegister ()
       // pulse STCP to latch in the register values
       PinPulseHiLo(g_nLatchPin);
    }
+#endif
+}
+#if SHIFTREG_USPI
+//-----------< FUNCTION: WriteComplete >-------------------------------------
+// Purpose:    USART SPI register write completion callback
+// Parameters: pTrans - the register write transaction
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID WriteComplete (PBUS_TRANSACTION pTrans)
+{
+   if (g_fDirty)
+   {
+      g_fDirty = FALSE;
+      USpiQueue(pTrans);
+   }
 }
+#endif
 //-----------< FUNCTION: ShiftRegInit >--------------------------------------
 // Purpose:    initializes the shift register module
 // Parameters: pConfig - shift register config
@@ -67,9 +102,25 @@ VOID ShiftRegInit (PSHIFTREG_CONFIG pConfig)
    g_nClockPin = pConfig->nClockPin;
    g_nLatchPin = pConfig->nLatchPin;
    g_nDataPin = pConfig->nDataPin;
+#if SHIFTREG_USPI
+   // shift out the last buffer byte first, MSB first, and latch the
+   // register on the rising edge of the slave select
+   for (UI8 i = 0; i < SHIFTREG_SIZE; i++)
+   {
+      g_pSegments[i].pbSend = &g_pbBuffer[SHIFTREG_SIZE - 1 - i];
+      g_pSegments[i].cbData = 1;
+   }
+   g_Trans.nAddress      = g_nLatchPin;
+   g_Trans.pSegments     = g_pSegments;
+   g_Trans.cSegments     = SHIFTREG_SIZE;
+   g_Trans.pfnOnComplete = WriteComplete;
+   PinSetHi(g_nLatchPin);
+   PinSetOutput(g_nLatchPin);
+#else
    PinSetOutput(g_nClockPin);
    PinSetOutput(g_nLatchPin);
    PinSetOutput(g_nDataPin);
+#endif
    WriteRegister();
 }
 //-----------< FUNCTION: ShiftRegRead >--------------------------------------
@@ -30,11 +30,23 @@
 //===========================================================================
 // SHIFT REGISTER CONFIGURATION
 // . SHIFTREG_SIZE:           size of the shift register array, in bytes
+// . SHIFTREG_USPI:           set to 1 to shift out over the USART SPI
+//                            bus (uspimast) instead of bit banging
+//                            - SHCP must be wired to XCK and DS to TXD,
+//                              and the clock/data pins are ignored
+//                            - STCP is driven as the slave select, so the
+//                              register latches at the end of the transfer
+//                            - writes are queued, and return before the
+//                              register is latched
+//                            - USpiInit must be called first
 //===========================================================================
 // configuration properties
 #ifndef SHIFTREG_SIZE
 #  define SHIFTREG_SIZE       (1)
 #endif
+#ifndef SHIFTREG_USPI
+#  define SHIFTREG_USPI       0
+#endif
 // configuration structure
 typedef struct tagShiftRegConfig
 {
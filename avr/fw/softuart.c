@@ -0,0 +1,185 @@
+//===========================================================================
+// Module:  softuart.c
+// Purpose: AVR timer/input capture software UART
+//
+// Copyright © 2013
+// Brent M. Spell. All rights reserved.
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version. This library is distributed in the
+// hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Lesser General Public License for more details. You should
+// have received a copy of the GNU Lesser General Public License along with
+// this library; if not, write to
+//    Free Software Foundation, Inc.
+//    51 Franklin Street, Fifth Floor
+//    Boston, MA 02110-1301 USA
+//===========================================================================
+//-------------------[       Pre Include Defines       ]-------------------//
+//-------------------[      Library Include Files      ]-------------------//
+//-------------------[      Project Include Files      ]-------------------//
+#include "softuart.h"
+#include "fifo.h"
+//-------------------[       Module Definitions        ]-------------------//
+// OC1A output compare modes, which drive the next bit level on match
+#define SOFTUART_TX_MARK               (BitMask(COM1A1) | BitMask(COM1A0))
+#define SOFTUART_TX_SPACE              (BitMask(COM1A1))
+// delay before the first start bit of a burst, in timer ticks
+#define SOFTUART_TX_DELAY              (64)
+// transmit states, as the bit currently on the line
+#define SOFTUART_TX_STOP               (9)      // stop bit
+#define SOFTUART_TX_IDLE               (10)     // line idle after stop bit
+//-------------------[        Module Variables         ]-------------------//
+//-------------------[        Module Prototypes        ]-------------------//
+static VOID SoftUartStartSend ();
+//-------------------[         Implementation          ]-------------------//
+// software UART port
+// . the main loop produces into the send ring and the OC1A ISR consumes it
+// . the OC1B ISR produces into the receive ring and the main loop consumes it
+DECLARE_UART_POLICY(
+   g_hSoftUart,
+   SOFTUART_SEND_BUFFER_SIZE, SOFTUART_SEND_POLICY,
+   SOFTUART_RECV_BUFFER_SIZE, SOFTUART_RECV_POLICY,
+   SoftUartStartSend
+);
+// transmit state
+static volatile UI8 g_nTxBit = SOFTUART_TX_IDLE;   // bit on the line
+static BYTE g_bTxData = 0;                         // byte being sent
+static BYTE g_bTxShift = 0;                        // unsent data bits
+// receive state
+static UI8  g_nRxBit = 0;                          // data bits received
+static BYTE g_bRxShift = 0;                        // received data bits
+//-----------< FUNCTION: SoftUartInit >--------------------------------------
+// Purpose:    software UART initialization
+// Parameters: pConfig - configuration structure
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID SoftUartInit (PSOFTUART_CONFIG pConfig)
+{
+   g_hSoftUart->pfnOnSend = pConfig->pfnOnSend;
+   g_hSoftUart->pfnOnRecv = pConfig->pfnOnRecv;
+   // idle the transmit line at mark, by forcing a set-on-match compare
+   TCCR1A = SOFTUART_TX_MARK;                   // normal mode, OC1A set
+   TCCR1C = BitMask(FOC1A);                     // force OC1A high
+   PinSetOutput(PIN_OC1A);
+   PinSetPullUp(PIN_ICP1);
+   // free-running 16-bit timer, capturing falling (start bit) edges
+   TCCR1B = BitMask(ICNC1) |                    // noise canceler
+            AvrClk1Scale(1);                    // no prescaler
+   TIFR1  = BitMask(ICF1);                      // clear pending capture
+   TIMSK1 = BitMask(ICIE1);                     // enable capture interrupt
+}
+//-----------< FUNCTION: SoftUartGetHandle >---------------------------------
+// Purpose:    retrieves the software UART port handle, for the port API
+// Parameters: none
+// Returns:    the software UART port handle
+//---------------------------------------------------------------------------
+UART_HANDLE SoftUartGetHandle ()
+{
+   return g_hSoftUart;
+}
+//-----------< FUNCTION: SoftUartStartSend >---------------------------------
+// Purpose:    starts the transmitter, if it is idle
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID SoftUartStartSend ()
+{
+   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+   {
+      if (!RegGet(TIMSK1, OCIE1A))
+      {
+         // schedule a compare on the idle line, which loads the
+         // first byte and programs its start bit
+         g_nTxBit = SOFTUART_TX_STOP;
+         TCCR1A   = SOFTUART_TX_MARK;
+         OCR1A    = TCNT1 + SOFTUART_TX_DELAY;
+         TIFR1    = BitMask(OCF1A);
+         RegSetHi(TIMSK1, OCIE1A);
+      }
+   }
+}
+//-----------< INTERRUPT: TIMER1_COMPA_vect >--------------------------------
+// Purpose:    programs the next transmit bit
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+ISR(TIMER1_COMPA_vect)
+{
+   // the compare has just driven a bit onto the line, so program
+   // the level of the following bit, one bit period later
+   // . bit 0 is the start bit, bits 1-8 are the data bits (LSB first)
+   //   and bit 9 is the stop bit
+   OCR1A += SOFTUART_BIT_TICKS;
+   UI8 nBit = ++g_nTxBit;
+   if (nBit <= 8)
+   {
+      TCCR1A = (g_bTxShift & 1) ? SOFTUART_TX_MARK : SOFTUART_TX_SPACE;
+      g_bTxShift >>= 1;
+   }
+   else if (nBit == SOFTUART_TX_STOP)
+      TCCR1A = SOFTUART_TX_MARK;
+   else if (!RingIsEmpty(g_hSoftUart->pSendRing))
+   {
+      // the stop bit is on the line (or the line is idle), so start
+      // the next byte when it ends
+      g_bTxData = g_bTxShift = RingRead(g_hSoftUart->pSendRing);
+      g_nTxBit  = 0;
+      TCCR1A    = SOFTUART_TX_SPACE;
+      if (g_hSoftUart->pfnOnSend != NULL)
+         g_hSoftUart->pfnOnSend(g_bTxData);
+   }
+   else if (nBit > SOFTUART_TX_IDLE)
+   {
+      // the stop bit has completed with nothing left to send,
+      // so idle the transmitter
+      g_nTxBit = SOFTUART_TX_IDLE;
+      RegSetLo(TIMSK1, OCIE1A);
+   }
+}
+//-----------< INTERRUPT: TIMER1_CAPT_vect >---------------------------------
+// Purpose:    responds to the falling edge of a start bit
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+ISR(TIMER1_CAPT_vect)
+{
+   // sample the first data bit at its center, 1.5 bits after the
+   // captured start bit edge, and ignore edges until the stop bit
+   OCR1B      = ICR1 + SOFTUART_BIT_TICKS + SOFTUART_BIT_TICKS / 2;
+   g_nRxBit   = 0;
+   g_bRxShift = 0;
+   TIFR1      = BitMask(OCF1B);
+   TIMSK1     = (TIMSK1 & BitUnmask(ICIE1)) | BitMask(OCIE1B);
+}
+//-----------< INTERRUPT: TIMER1_COMPB_vect >--------------------------------
+// Purpose:    samples the next receive bit
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+ISR(TIMER1_COMPB_vect)
+{
+   BOOL fMark = PinRead(PIN_ICP1);
+   OCR1B += SOFTUART_BIT_TICKS;
+   if (g_nRxBit < 8)
+   {
+      g_bRxShift = (g_bRxShift >> 1) | (fMark ? 0x80 : 0x00);
+      g_nRxBit++;
+   }
+   else
+   {
+      // stop bit sample, deliver the byte if it was framed correctly,
+      // then wait for the next start bit
+      TIFR1  = BitMask(ICF1);
+      TIMSK1 = (TIMSK1 & BitUnmask(OCIE1B)) | BitMask(ICIE1);
+      if (fMark)
+      {
+         RingWrite(g_hSoftUart->pRecvRing, g_bRxShift);
+         if (g_hSoftUart->pfnOnRecv != NULL)
+            g_hSoftUart->pfnOnRecv(g_bRxShift);
+      }
+   }
+}
@@ -0,0 +1,97 @@
+//===========================================================================
+// Module:  softuart.h
+// Purpose: AVR timer/input capture software UART
+//
+// Copyright © 2013
+// Brent M. Spell. All rights reserved.
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version. This library is distributed in the
+// hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Lesser General Public License for more details. You should
+// have received a copy of the GNU Lesser General Public License along with
+// this library; if not, write to
+//    Free Software Foundation, Inc.
+//    51 Franklin Street, Fifth Floor
+//    Boston, MA 02110-1301 USA
+//===========================================================================
+#ifndef __SOFTUART_H
+#define __SOFTUART_H
+//-------------------[       Pre Include Defines       ]-------------------//
+//-------------------[      Library Include Files      ]-------------------//
+//-------------------[      Project Include Files      ]-------------------//
+#ifndef __AVRDEFS_H
+#include "avrdefs.h"
+#endif
+#ifndef __UART_H
+#include "uart.h"
+#endif
+//-------------------[       Module Definitions        ]-------------------//
+//===========================================================================
+// SOFTWARE UART CONFIGURATION
+// . SOFTUART_BAUD               software UART baud rate (8N1)
+// . SOFTUART_SEND_BUFFER_SIZE   send buffer size (power of 2, up to 128)
+// . SOFTUART_RECV_BUFFER_SIZE   receive buffer size (power of 2, up to 128)
+// . SOFTUART_SEND_POLICY        send buffer overflow policy
+// . SOFTUART_RECV_POLICY        receive buffer overflow policy
+//===========================================================================
+#ifndef SOFTUART_BAUD
+#  define SOFTUART_BAUD                (9600)
+#endif
+#ifndef SOFTUART_SEND_BUFFER_SIZE
+#  define SOFTUART_SEND_BUFFER_SIZE    (16)
+#endif
+#ifndef SOFTUART_RECV_BUFFER_SIZE
+#  define SOFTUART_RECV_BUFFER_SIZE    (16)
+#endif
+#ifndef SOFTUART_SEND_POLICY
+#  define SOFTUART_SEND_POLICY         FIFO_POLICY_REJECT
+#endif
+#ifndef SOFTUART_RECV_POLICY
+#  define SOFTUART_RECV_POLICY         FIFO_POLICY_DROP
+#endif
+// bit period, in timer 1 ticks (no prescaler)
+#define SOFTUART_BIT_TICKS             ((F_CPU + SOFTUART_BAUD / 2) / SOFTUART_BAUD)
+#if SOFTUART_BIT_TICKS > 65535
+#  error SOFTUART_BAUD is too low for the 16-bit bit timer
+#endif
+#if SOFTUART_BIT_TICKS < 160
+#  error SOFTUART_BAUD is too high for interrupt-timed bits
+#endif
+//===========================================================================
+// SOFTWARE UART RESOURCES
+// . the software UART owns timer 1, which runs free at F_CPU, so it
+//   cannot be combined with other timer 1 users (quadbay, hcsr04)
+// . transmit uses output compare A, which drives OC1A (PB1/Arduino D9)
+//   in hardware at each bit boundary, so bit edges are free of interrupt
+//   latency jitter
+// . receive uses input capture on ICP1 (PB0/Arduino D8) to timestamp the
+//   start bit, and output compare B to sample each data bit at its center
+// . send and receive are full duplex; each bit costs one interrupt, which
+//   keeps the CPU load reasonable up to about 38400 baud at 16MHz
+//===========================================================================
+typedef struct tagSoftUartConfig
+{
+   UART_CALLBACK  pfnOnSend;           // send complete callback
+   UART_CALLBACK  pfnOnRecv;           // receive complete callback
+} SOFTUART_CONFIG, *PSOFTUART_CONFIG;
+//===========================================================================
+// SOFTWARE UART INTERFACE
+//===========================================================================
+VOID        SoftUartInit      (PSOFTUART_CONFIG pConfig);
+UART_HANDLE SoftUartGetHandle ();
+// port API helpers
+inline UI8 SoftUartSendReady ()
+   { return UartPortSendReady(SoftUartGetHandle()); }
+inline VOID SoftUartSend (PCVOID pvData, UI8 cbData)
+   { UartPortSend(SoftUartGetHandle(), pvData, cbData); }
+inline UI8 SoftUartTrySend (PCVOID pvData, UI8 cbData)
+   { return UartPortTrySend(SoftUartGetHandle(), pvData, cbData); }
+inline UI8 SoftUartRecvReady ()
+   { return UartPortRecvReady(SoftUartGetHandle()); }
+inline UI8 SoftUartRecv (PVOID pvData, UI8 cbData)
+   { return UartPortRecv(SoftUartGetHandle(), pvData, cbData); }
+#endif // __SOFTUART_H
@@ -23,12 +23,41 @@
 //-------------------[      Project Include Files      ]-------------------//
 #include "spimast.h"
 //-------------------[       Module Definitions        ]-------------------//
+#if SPI_FREQUENCY < F_CPU / 128
+#  error SPI_FREQUENCY is below the minimum SCK rate (F_CPU/128)
+#endif
 //-------------------[        Module Variables         ]-------------------//
-static volatile UI8  g_nSsPin = PIN_INVALID;       // slave select pin
-static volatile BYTE g_pbBuffer[SPI_BUFFER_SIZE];  // send/receive buffer
-static volatile BYTE g_cbBuffer = 0;               // current buffer length
-static volatile SPI_CALLBACK g_pfnCallback = NULL; // completion callback
+// default bus settings, for transactions without a device
+static const SPI_DEVICE g_DefaultDevice =
+   SPI_DEVICE_INIT(SPI_FREQUENCY, SPI_LSB, SPI_CPOL, SPI_CPHA);
+// transaction queue
+// . the head transaction is the one in progress on the bus
+static PBUS_TRANSACTION volatile g_pHead = NULL;   // queue head
+static PBUS_TRANSACTION volatile g_pTail = NULL;   // queue tail
+// head transfer cursor
+// . the current segment of the head transaction, or the whole transaction
+//   if it is not segmented; only accessed with interrupts disabled
+static PCBYTE g_pbSend = NULL;                     // segment send buffer
+static BSIZE g_cbSend = 0;                         // segment send length
+static PBYTE g_pbRecv = NULL;                      // segment receive buffer
+static BSIZE g_cbRecv = 0;                         // segment receive length
+static BSIZE g_cbXfer = 0;                         // segment exchange length
+static BSIZE g_nXfer = 0;                          // segment bytes exchanged
+static PBUS_SEGMENT g_pSegment = NULL;             // next segment
+static UI8 g_cSegments = 0;                        // segments remaining
 //-------------------[        Module Prototypes        ]-------------------//
+static BSIZE SpiTransLength (PBUS_TRANSACTION pTrans);
+static inline VOID SpiConfigure (PCVOID pvDevice);
+static inline VOID SpiSelectDelay (PCVOID pvDevice);
+static inline BOOL SpiCanPoll (PBUS_TRANSACTION pTrans);
+static VOID SpiStart (PBUS_TRANSACTION pTrans);
+static BOOL SpiNextSegment ();
+static VOID SpiPoll (PBUS_TRANSACTION pTrans);
+static VOID SpiPollXfer (
+   PCBYTE pbSend,
+   BSIZE  cbSend,
+   PBYTE  pbRecv,
+   BSIZE  cbRecv);
 //-------------------[         Implementation          ]-------------------//
 //-----------< FUNCTION: SpiInit >-------------------------------------------
 // Purpose:    SPI interface initialization
@@ -41,31 +70,49 @@ VOID SpiInit ()
    PinSetOutput(PIN_MOSI);
    PinSetOutput(PIN_SS);
    PinSetHi(PIN_SS);
-   SPCR = (1 << SPE) | (1 << MSTR) |         // enable SPI master mode
-          (SPI_LSB  << DORD) |               // set bit order
-          (SPI_CPOL << CPOL) |               // set clock polarity
-          (SPI_CPHA << CPHA);                // set clock phase
-   // set clock frequency registers
-#if (F_CPU / SPI_FREQUENCY == 2)             
-   SPCR |= (0 << SPR1) | (0 << SPR0);
-   SPSR |= (1 << SPI2X);
-#elif (F_CPU / SPI_FREQUENCY == 4)
-   SPCR |= (0 << SPR1) | (0 << SPR0);
-#elif (F_CPU / SPI_FREQUENCY == 8)
-   SPCR |= (0 << SPR1) | (1 << SPR0);
-   SPSR |= (1 << SPI2X);
-#elif (F_CPU / SPI_FREQUENCY == 16)
-   SPCR |= (0 << SPR1) | (1 << SPR0);
-#elif (F_CPU / SPI_FREQUENCY == 32)
-   SPCR |= (1 << SPR1) | (0 << SPR0);
-   SPSR |= (1 << SPI2X);
-#elif (F_CPU / SPI_FREQUENCY == 64)
-   SPCR |= (1 << SPR1) | (0 << SPR0);
-#elif (F_CPU / SPI_FREQUENCY == 128)
-   SPCR |= (1 << SPR1) | (1 << SPR0);
-#else
-#  error invalid SPI_FREQUENCY value
-#endif   
+   SpiConfigure(NULL);
+}
+//-----------< FUNCTION: SpiConfigure >--------------------------------------
+// Purpose:    applies a device's bus settings to the SPI hardware
+//             the bus must be idle, with no slave selected
+// Parameters: pvDevice - the device settings (SPI_DEVICE, or NULL for
+//                        the default)
+// Returns:    none
+//---------------------------------------------------------------------------
+static inline VOID SpiConfigure (PCVOID pvDevice)
+{
+   PCSPI_DEVICE pDevice = pvDevice != NULL ? pvDevice : &g_DefaultDevice;
+   SPCR = pDevice->bControl;
+   SPSR = pDevice->bStatus;
+}
+//-----------< FUNCTION: SpiSelectDelay >------------------------------------
+// Purpose:    waits out a device's slave select setup/hold time
+// Parameters: pvDevice - the device settings (SPI_DEVICE, or NULL for
+//                        the default, which has no delay)
+// Returns:    none
+//---------------------------------------------------------------------------
+static inline VOID SpiSelectDelay (PCVOID pvDevice)
+{
+   if (pvDevice != NULL)
+      for (UI8 n = ((PCSPI_DEVICE)pvDevice)->nSelectDelay; n != 0; n--)
+         _delay_us(1);
+}
+//-----------< FUNCTION: SpiCanPoll >----------------------------------------
+// Purpose:    determines whether a transaction is short enough to poll
+//             with interrupts disabled
+//             . slow devices (F_CPU/32 or slower, SPR1 set) and devices
+//               with a select delay would hold interrupts off too long
+// Parameters: pTrans - the transaction to check
+// Returns:    TRUE if the transaction may be polled
+//             FALSE otherwise
+//---------------------------------------------------------------------------
+static inline BOOL SpiCanPoll (PBUS_TRANSACTION pTrans)
+{
+   PCSPI_DEVICE pDevice = pTrans->pvDevice;
+   if (pDevice != NULL &&
+       ((pDevice->bControl & (1 << SPR1)) || pDevice->nSelectDelay != 0))
+      return FALSE;
+   return SpiTransLength(pTrans) <= SPI_POLL_THRESHOLD;
 }
 //-----------< FUNCTION: SpiIsBusy >-----------------------------------------
 // Purpose:    polls the SPI busy state
@@ -75,8 +122,8 @@ VOID SpiInit ()
 //---------------------------------------------------------------------------
 BOOL SpiIsBusy ()
 {
-   // busy if the interrupt is enabled
-   return RegGet(SPCR, SPIE);
+   // busy while any transaction is queued
+   return g_pHead != NULL;
 }
 //-----------< FUNCTION: SpiWait >-------------------------------------------
 // Purpose:    waits for the SPI bus to become available
@@ -88,60 +135,150 @@ VOID SpiWait ()
    while (SpiIsBusy())
       ;
 }
-//-----------< FUNCTION: SpiBeginSendRecv >----------------------------------
-// Purpose:    start a combined send/receive transaction on the SPI bus
-// Parameters: nSsPin      - slave select pin number (or PIN_INVALID for no SS)
-//             pvSend      - send message buffer
-//             cbSend      - number of bytes to send
-//             cbRecv      - number of bytes to receive
-//             pfnCallback - completion callback
+//-----------< FUNCTION: SpiQueue >------------------------------------------
+// Purpose:    queues a transaction on the SPI bus, starting it if the
+//             bus is idle
+// Parameters: pTrans - the transaction to queue, which must not already
+//                      be queued
 // Returns:    none
 //---------------------------------------------------------------------------
-VOID SpiBeginSendRecv (
-   UI8          nSsPin, 
-   PCVOID       pvSend, 
-   BSIZE        cbSend,
-   BSIZE        cbRecv,
-   SPI_CALLBACK pfnCallback)
+VOID SpiQueue (PBUS_TRANSACTION pTrans)
 {
-   // wait for and enable the interrupt to lock SPI
-   SpiWait();
+   // empty transactions complete immediately
+   if (SpiTransLength(pTrans) == 0)
+   {
+      pTrans->fBusy   = FALSE;
+      pTrans->nStatus = BUS_STATUS_OK;
+      if (pTrans->pfnOnComplete != NULL)
+         pTrans->pfnOnComplete(pTrans);
+      return;
+   }
    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
    {
-      // set up SPI state and transfer the send buffer
-      g_nSsPin = nSsPin;
-      cbSend = Min(cbSend, SPI_BUFFER_SIZE);
-      cbRecv = Min(cbRecv, SPI_BUFFER_SIZE);
-      g_cbBuffer = Max(cbSend, cbRecv);
-      g_pfnCallback = pfnCallback;
-      if (pvSend != NULL)
-         memcpy((PBYTE)g_pbBuffer, pvSend, cbSend);
-      if (cbRecv > cbSend)
-         memzero((PBYTE)g_pbBuffer + cbSend, cbRecv - cbSend);
-      // enable the slave and transfer the first byte
-      if (g_nSsPin != PIN_INVALID)
-         PinSetLo(g_nSsPin);
-      // start the SPI transaction
-      SPDR = g_pbBuffer[0];
-      RegSetHi(SPCR, SPIE);
+      pTrans->pNext   = NULL;
+      pTrans->fBusy   = TRUE;
+      pTrans->nStatus = BUS_STATUS_BUSY;
+      if (g_pHead == NULL)
+      {
+         g_pHead = g_pTail = pTrans;
+         SpiStart(pTrans);
+      }
+      else
+      {
+         g_pTail->pNext = pTrans;
+         g_pTail = pTrans;
+      }
    }
 }
-//-----------< FUNCTION: SpiEndSendRecv >------------------------------------
-// Purpose:    completes a send/receive transaction
-// Parameters: pvRecv - receive message buffer
-//             cbRecv      - number of bytes to receive
-// Returns:    actual number of bytes received
+//-----------< FUNCTION: SpiTransLength >-----------------------------------
+// Purpose:    calculates the number of bytes exchanged by a transaction
+// Parameters: pTrans - the transaction to measure
+// Returns:    the total exchange length, in bytes
 //---------------------------------------------------------------------------
-UI8 SpiEndSendRecv (PVOID pvRecv, UI8 cbRecv)
+static BSIZE SpiTransLength (PBUS_TRANSACTION pTrans)
 {
-   SpiWait();
-   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+   if (pTrans->cSegments == 0)
+      return Max(pTrans->cbSend, pTrans->cbRecv);
+   BSIZE cbXfer = 0;
+   for (UI8 i = 0; i < pTrans->cSegments; i++)
+      cbXfer += pTrans->pSegments[i].cbData;
+   return cbXfer;
+}
+//-----------< FUNCTION: SpiSendByte >---------------------------------------
+// Purpose:    retrieves the next byte to send from the transfer cursor
+// Parameters: nXfer - the index of the byte in the current segment
+// Returns:    the byte to send
+//---------------------------------------------------------------------------
+static inline BYTE SpiSendByte (BSIZE nXfer)
+{
+   return (nXfer < g_cbSend && g_pbSend != NULL) ? g_pbSend[nXfer] : 0;
+}
+//-----------< FUNCTION: SpiStart >------------------------------------------
+// Purpose:    starts the transaction at the head of the queue
+// Parameters: pTrans - the head transaction, which must not be empty
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID SpiStart (PBUS_TRANSACTION pTrans)
+{
+   // point the transfer cursor at the first non-empty segment,
+   // or at the transaction buffers
+   g_cSegments = pTrans->cSegments;
+   if (g_cSegments != 0)
+   {
+      g_pSegment = pTrans->pSegments;
+      SpiNextSegment();
+   }
+   else
+   {
+      g_pbSend = pTrans->pbSend;
+      g_cbSend = pTrans->cbSend;
+      g_pbRecv = pTrans->pbRecv;
+      g_cbRecv = pTrans->cbRecv;
+      g_cbXfer = Max(g_cbSend, g_cbRecv);
+      g_nXfer  = 0;
+   }
+   // apply the device settings, then enable the slave
+   // and transfer the first byte
+   SpiConfigure(pTrans->pvDevice);
+   if (pTrans->nAddress != PIN_INVALID)
+   {
+      PinSetLo(pTrans->nAddress);
+      SpiSelectDelay(pTrans->pvDevice);
+   }
+   SPDR = SpiSendByte(0);
+   RegSetHi(SPCR, SPIE);
+}
+//-----------< FUNCTION: SpiNextSegment >------------------------------------
+// Purpose:    advances the transfer cursor to the next non-empty segment
+//             of the head transaction
+// Parameters: none
+// Returns:    TRUE if a segment remains
+//             FALSE if the transaction is complete
+//---------------------------------------------------------------------------
+static BOOL SpiNextSegment ()
+{
+   while (g_cSegments != 0)
    {
-      cbRecv = Min(cbRecv, g_cbBuffer);
-      if (pvRecv != NULL)
-         memcpy(pvRecv, (PVOID)g_pbBuffer, cbRecv);
+      PBUS_SEGMENT pSegment = g_pSegment++;
+      g_cSegments--;
+      if (pSegment->cbData != 0)
+      {
+         g_pbSend = pSegment->pbSend;
+         g_pbRecv = pSegment->pbRecv;
+         g_cbSend = g_cbRecv = g_cbXfer = pSegment->cbData;
+         g_nXfer  = 0;
+         return TRUE;
+      }
    }
-   return cbRecv;
+   return FALSE;
+}
+//-----------< FUNCTION: SpiExecute >----------------------------------------
+// Purpose:    executes a transaction synchronously
+//             short transfers are faster to poll than to run from the ISR,
+//             but the bus must be idle, so wait for any queued transactions
+// Parameters: pTrans - the transaction to execute
+// Returns:    the transaction status (BUS_STATUS_*)
+//---------------------------------------------------------------------------
+UI8 SpiExecute (PBUS_TRANSACTION pTrans)
+{
+#if SPI_POLL_THRESHOLD > 0
+   if (SpiCanPoll(pTrans))
+   {
+      for ( ; ; )
+      {
+         ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+         {
+            if (g_pHead == NULL)
+            {
+               SpiPoll(pTrans);
+               return pTrans->nStatus;
+            }
+         }
+      }
+   }
+#endif
+   SpiQueue(pTrans);
+   return BusTransWait(pTrans);
 }
 //-----------< FUNCTION: SpiSendRecv >---------------------------------------
 // Purpose:    executes a combined send/receive transaction on the SPI bus
@@ -152,17 +289,107 @@ UI8 SpiEndSendRecv (PVOID pvRecv, UI8 cbRecv)
 //             cbRecv - number of bytes to receive
 // Returns:    actual number of bytes received
 //---------------------------------------------------------------------------
-UI8 SpiSendRecv (
+BSIZE SpiSendRecv (
    UI8    nSsPin, 
    PCVOID pvSend, 
    BSIZE  cbSend,
    PVOID  pvRecv, 
    BSIZE  cbRecv)
 {
-   SpiBeginSendRecv(nSsPin, pvSend, cbSend, cbRecv, NULL);
-   if (pvRecv != NULL)
-      return SpiEndSendRecv(pvRecv, cbRecv);
-   return 0;
+   // exchange directly with the caller's buffers
+   BUS_TRANSACTION trans =
+   {
+      .nAddress = nSsPin,
+      .pbSend   = pvSend,
+      .cbSend   = cbSend,
+      .pbRecv   = pvRecv,
+      .cbRecv   = cbRecv
+   };
+   SpiExecute(&trans);
+   return pvRecv != NULL ? cbRecv : 0;
+}
+//-----------< FUNCTION: SpiSendRecvV >--------------------------------------
+// Purpose:    executes a segmented send/receive transaction on the SPI bus
+//             under a single slave select
+// Parameters: nSsPin    - slave select pin number (or PIN_INVALID for no SS)
+//             pSegments - the segments to exchange, in order
+//             cSegments - the number of segments
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID SpiSendRecvV (
+   UI8          nSsPin,
+   PBUS_SEGMENT pSegments,
+   UI8          cSegments)
+{
+   BUS_TRANSACTION trans =
+   {
+      .nAddress  = nSsPin,
+      .pSegments = pSegments,
+      .cSegments = cSegments
+   };
+   SpiExecute(&trans);
+}
+//-----------< FUNCTION: SpiPoll >-------------------------------------------
+// Purpose:    executes a transaction by polling the SPI interrupt flag, with
+//             the bus idle and interrupts disabled
+// Parameters: pTrans - the transaction to execute
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID SpiPoll (PBUS_TRANSACTION pTrans)
+{
+   SpiConfigure(pTrans->pvDevice);
+   if (pTrans->nAddress != PIN_INVALID)
+      PinSetLo(pTrans->nAddress);
+   if (pTrans->cSegments == 0)
+      SpiPollXfer(
+         pTrans->pbSend, 
+         pTrans->cbSend, 
+         pTrans->pbRecv, 
+         pTrans->cbRecv
+      );
+   for (UI8 i = 0; i < pTrans->cSegments; i++)
+   {
+      PBUS_SEGMENT pSegment = &pTrans->pSegments[i];
+      SpiPollXfer(
+         pSegment->pbSend, 
+         pSegment->cbData, 
+         pSegment->pbRecv, 
+         pSegment->cbData
+      );
+   }
+   if (pTrans->nAddress != PIN_INVALID)
+      PinSetHi(pTrans->nAddress);
+   // complete the transaction as the ISR would
+   pTrans->fBusy   = FALSE;
+   pTrans->nStatus = BUS_STATUS_OK;
+   if (pTrans->pfnOnComplete != NULL)
+      pTrans->pfnOnComplete(pTrans);
+}
+//-----------< FUNCTION: SpiPollXfer >---------------------------------------
+// Purpose:    exchanges a buffer by polling the SPI interrupt flag
+// Parameters: pbSend - send message buffer (or NULL to send zeros)
+//             cbSend - number of bytes to send
+//             pbRecv - receive message buffer (or NULL to discard)
+//             cbRecv - number of bytes to receive
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID SpiPollXfer (
+   PCBYTE pbSend,
+   BSIZE  cbSend,
+   PBYTE  pbRecv,
+   BSIZE  cbRecv)
+{
+   BSIZE cbXfer = Max(cbSend, cbRecv);
+   for (BSIZE i = 0; i < cbXfer; i++)
+   {
+      // reading SPSR with SPIF set, then SPDR, clears the flag
+      SPDR = (i < cbSend && pbSend != NULL) ? pbSend[i] : 0;
+      while (!RegGet(SPSR, SPIF))
+         ;
+      BYTE bRecv = SPDR;
+      if (i < cbRecv && pbRecv != NULL)
+         pbRecv[i] = bRecv;
+   }
 }
 //-----------< INTERRUPT: SPI_STC_vect >-------------------------------------
 // Purpose:    responds to SPI transfer complete events
@@ -171,22 +398,44 @@ UI8 SpiSendRecv (
 //---------------------------------------------------------------------------
 ISR(SPI_STC_vect)
 {
-   static UI8 g_cbXfer = 0;
+   PBUS_TRANSACTION pTrans = g_pHead;
+   BSIZE nXfer = g_nXfer;
    // transfer the received byte to the receive buffer
    // send the next byte while more data remains
-   g_pbBuffer[g_cbXfer++] = SPDR;
-   if (g_cbXfer < g_cbBuffer)
-      SPDR = g_pbBuffer[g_cbXfer];
+   BYTE bRecv = SPDR;
+   if (nXfer < g_cbRecv && g_pbRecv != NULL)
+      g_pbRecv[nXfer] = bRecv;
+   if (++nXfer < g_cbXfer)
+   {
+      SPDR = SpiSendByte(nXfer);
+      g_nXfer = nXfer;
+      return;
+   }
+   // continue with the next segment without releasing the slave
+   if (SpiNextSegment())
+   {
+      SPDR = SpiSendByte(0);
+      return;
+   }
+   // end the transaction on the slave
+   if (pTrans->nAddress != PIN_INVALID)
+   {
+      PinSetHi(pTrans->nAddress);
+      SpiSelectDelay(pTrans->pvDevice);
+   }
+   // start the next transaction back to back, or disable this
+   // interrupt to free up SPI
+   if ((g_pHead = pTrans->pNext) != NULL)
+      SpiStart(g_pHead);
    else
    {
-      g_cbXfer = 0;
-      // end the transaction on the slave
-      if (g_nSsPin != PIN_INVALID)
-         PinSetHi(g_nSsPin);
-      // disable this interrupt to free up SPI
+      g_pTail = NULL;
       RegSetLo(SPCR, SPIE);
-      // dispatch the callback
-      if (g_pfnCallback != NULL)
-         g_pfnCallback();
    }
+   // release the transaction and dispatch the callback,
+   // which may queue it again
+   pTrans->nStatus = BUS_STATUS_OK;
+   pTrans->fBusy   = FALSE;
+   if (pTrans->pfnOnComplete != NULL)
+      pTrans->pfnOnComplete(pTrans);
 }
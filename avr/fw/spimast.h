@@ -26,14 +26,27 @@
 #ifndef __AVRDEFS_H
 #include "avrdefs.h"
 #endif
+#ifndef __BUS_H
+#include "bus.h"
+#endif
 //-------------------[       Module Definitions        ]-------------------//
 //===========================================================================
 // SPI CONFIGURATION
+// . these are the default bus settings, used by transactions that do not
+//   specify an SPI device
 // . SPI_FREQUENCY            frequency of the SCK clock, in Hz
+//                            (the fastest rate that does not exceed this
+//                            is used, see SPI_ACTUAL_FREQUENCY)
 // . SPI_LSB                  set to TRUE to enable least-signifcant-bit first
 // . SPI_CPOL                 SPI mode for clock polarity
 // . SPI_CPHA                 SPI mode for clock phase
-// . SPI_BUFFER_SIZE          size of the SPI send/receive buffer, in bytes
+// . SPI_POLL_THRESHOLD       longest SpiSendRecv/SpiSendRecvV transfer
+//                            that is polled with interrupts disabled,
+//                            instead of queued to the ISR, in bytes
+//                            (0 to disable); devices clocked at F_CPU/32
+//                            or slower, or with a select delay, are
+//                            always queued, to bound the time spent
+//                            with interrupts disabled
 //===========================================================================
 #ifndef SPI_FREQUENCY
 #  define SPI_FREQUENCY       8000000
@@ -47,37 +60,94 @@
 #ifndef SPI_CPHA     
 #  define SPI_CPHA            0
 #endif
-#ifndef SPI_BUFFER_SIZE
-#  define SPI_BUFFER_SIZE     16
+#ifndef SPI_POLL_THRESHOLD
+#  define SPI_POLL_THRESHOLD  4
 #endif
 //===========================================================================
+// SPI DEVICES
+// . a device descriptor holds the bus settings (clock rate, bit order and
+//   mode) for one kind of slave, as precomputed SPCR/SPSR values
+// . the settings are applied at the start of each transaction (pvDevice),
+//   before the slave is selected, so devices with different settings can
+//   share the bus
+// . SPI_DEVICE_INIT(freq, lsb, cpol, cpha) initializes a descriptor at
+//   compile time, using the fastest clock rate that does not exceed freq
+//   (SCK = F_CPU / 2^n, for n in 1..7); SPI_DEVICE_FREQUENCY(freq) reports
+//   the resulting SCK frequency, in Hz
+// . SPI_DEVICE_INIT_DELAY(freq, lsb, cpol, cpha, us) also sets a delay
+//   after the slave is selected and after it is released, for slaves
+//   with select setup/hold times; the delay runs in the SPI ISR when
+//   transactions are chained
+//===========================================================================
+typedef struct tagSpiDevice
+{
+   BYTE              bControl;            // SPCR mode, bit order and rate
+   BYTE              bStatus;             // SPSR double speed flag
+   UI8               nSelectDelay;        // select setup/hold time, in us
+} SPI_DEVICE, *PSPI_DEVICE;
+typedef const SPI_DEVICE* PCSPI_DEVICE;
+#define __SPI_DIVISOR(f)                                                   \
+   ((F_CPU) /  2 <= (f) ?  2 : (F_CPU) /  4 <= (f) ?  4 :                  \
+    (F_CPU) /  8 <= (f) ?  8 : (F_CPU) / 16 <= (f) ? 16 :                  \
+    (F_CPU) / 32 <= (f) ? 32 : (F_CPU) / 64 <= (f) ? 64 : 128)
+#define __SPI_RATE(d)                                                      \
+   ((d) <= 4 ? 0 : (d) <= 16 ? (1 << SPR0) :                               \
+    (d) <= 64 ? (1 << SPR1) : (1 << SPR1) | (1 << SPR0))
+#define __SPI_2X(d)                                                        \
+   ((d) == 2 || (d) == 8 || (d) == 32 ? (1 << SPI2X) : 0)
+#define SPI_DEVICE_FREQUENCY(freq)                                         \
+   ((F_CPU) / __SPI_DIVISOR(freq))
+#define SPI_ACTUAL_FREQUENCY                                               \
+   SPI_DEVICE_FREQUENCY(SPI_FREQUENCY)
+#define SPI_DEVICE_INIT_DELAY(freq, lsb, cpol, cpha, us)                   \
+   {                                                                       \
+      .bControl = (1 << SPE) | (1 << MSTR) |                               \
+                  ((lsb)  << DORD) |                                       \
+                  ((cpol) << CPOL) |                                       \
+                  ((cpha) << CPHA) |                                       \
+                  __SPI_RATE(__SPI_DIVISOR(freq)),                         \
+      .bStatus  = __SPI_2X(__SPI_DIVISOR(freq)),                           \
+      .nSelectDelay = (us)                                                 \
+   }
+#define SPI_DEVICE_INIT(freq, lsb, cpol, cpha)                             \
+   SPI_DEVICE_INIT_DELAY(freq, lsb, cpol, cpha, 0)
+//===========================================================================
+// SPI TRANSACTIONS
+// . SPI transactions are bus transactions (see bus.h), addressed by slave
+//   select pin, which are queued with SpiQueue, or run synchronously with
+//   SpiExecute
+// . the exchange length is the larger of cbSend and cbRecv; zeros are
+//   sent after the send buffer (or for a NULL send buffer), and bytes
+//   received after cbRecv (or for a NULL receive buffer) are discarded
+// . the send and receive buffers may be the same buffer
+// . each segment exchanges cbData bytes under the same slave select
+// . the SPI ISR starts each queued transaction as soon as the previous
+//   one completes, then calls its completion callback
+// . SPI transactions always complete with BUS_STATUS_OK
+//===========================================================================
+//===========================================================================
 // SPI INTERFACE
 //===========================================================================
-// SPI callback
-typedef VOID (*SPI_CALLBACK)  ();
 // SPI API
 VOID     SpiInit           ();
 BOOL     SpiIsBusy         ();
 VOID     SpiWait           ();
-VOID     SpiBeginSendRecv  (UI8          nSsPin, 
-                            PCVOID       pvSend, 
-                            BSIZE        cbSend,
-                            BSIZE        cbRecv,
-                            SPI_CALLBACK pfnCallback);
-UI8      SpiEndSendRecv    (PVOID        pvRecv, 
-                            UI8          cbRecv);
-UI8      SpiSendRecv       (UI8          nSsPin, 
+VOID     SpiQueue          (PBUS_TRANSACTION pTrans);
+UI8      SpiExecute        (PBUS_TRANSACTION pTrans);
+BSIZE    SpiSendRecv       (UI8          nSsPin, 
                             PCVOID       pvSend, 
                             BSIZE        cbSend,
                             PVOID        pvRecv, 
                             BSIZE        cbRecv);
+VOID     SpiSendRecvV      (UI8          nSsPin,
+                            PBUS_SEGMENT pSegments,
+                            UI8          cSegments);
 // SPI one-way helpers
 inline VOID SpiSend (UI8 nSsPin, PCVOID pvSend, BSIZE cbSend)
-   { SpiBeginSendRecv(nSsPin, pvSend, cbSend, 0, NULL); }
-inline VOID SpiBeginRecv (UI8 nSsPin, BSIZE cbRecv, SPI_CALLBACK pfnCallback)
-   { SpiBeginSendRecv(nSsPin, NULL, 0, cbRecv, pfnCallback); }
-inline UI8 SpiEndRecv (PVOID pvRecv, BSIZE cbRecv)
-   { return SpiEndSendRecv(pvRecv, cbRecv); }
-inline UI8 SpiRecv (UI8 nSsPin, PVOID pvRecv, BSIZE cbRecv)
+   { SpiSendRecv(nSsPin, pvSend, cbSend, NULL, 0); }
+inline BSIZE SpiRecv (UI8 nSsPin, PVOID pvRecv, BSIZE cbRecv)
    { return SpiSendRecv(nSsPin, NULL, 0, pvRecv, cbRecv); }
+// SPI bus interface initializer
+#define SPI_BUS                                                            \
+   { .pfnQueue = SpiQueue, .pfnExecute = SpiExecute }
 #endif // __SPIMAST_H
@@ -123,6 +123,43 @@ static const UI8 g_pnTFallRegs[] =
 };
 //-------------------[        Module Prototypes        ]-------------------//
 //-------------------[         Implementation          ]-------------------//
+//-----------< FUNCTION: ReadRegister >--------------------------------------
+// Purpose:    reads one or more consecutive SX1509 registers over I2C
+// Parameters: nModule - SX1509 module number
+//             nReg    - first register address
+//             pvData  - return register data via here
+//             cbData  - the number of bytes to read
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID ReadRegister (UI8 nModule, UI8 nReg, PVOID pvData, BSIZE cbData)
+{
+   // receive directly into the caller's buffer
+   I2cSendRecv(g_pI2cAddress[nModule], &nReg, 1, pvData, cbData);
+}
+//-----------< FUNCTION: WriteRegister >-------------------------------------
+// Purpose:    writes one or more consecutive SX1509 registers over I2C
+// Parameters: nModule - SX1509 module number
+//             nReg    - first register address
+//             pvData  - register data to write
+//             cbData  - the number of bytes to write
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID WriteRegister (UI8 nModule, UI8 nReg, PCVOID pvData, BSIZE cbData)
+{
+   // send the register address and the caller's data in one write
+   BUS_SEGMENT pSegments[] =
+   {
+      { .pbSend = &nReg,  .pbRecv = NULL, .cbData = 1 },
+      { .pbSend = pvData, .pbRecv = NULL, .cbData = cbData }
+   };
+   BUS_TRANSACTION trans =
+   {
+      .nAddress  = g_pI2cAddress[nModule],
+      .pSegments = pSegments,
+      .cSegments = 2
+   };
+   I2cExecute(&trans);
+}
 //-----------< FUNCTION: SX1509Init >----------------------------------------
 // Purpose:    SX1509 interface initialization
 // Parameters: none
@@ -140,7 +177,7 @@ VOID SX1509Init ()
 UI8 SX1509Get8 (UI8 nModule, UI8 nReg)
 {
    BYTE pbData[1] = { 0, };
-   I2cSendRecv(g_pI2cAddress[nModule], &nReg, 1, pbData, sizeof(pbData));
+   ReadRegister(nModule, nReg, pbData, sizeof(pbData));
    return pbData[0];
 }
 //-----------< FUNCTION: SX1509Set8 >----------------------------------------
@@ -151,8 +188,7 @@ UI8 SX1509Get8 (UI8 nModule, UI8 nReg)
 //---------------------------------------------------------------------------
 VOID SX1509Set8 (UI8 nModule, UI8 nReg, UI8 nValue)
 {
-   BYTE pbData[] = { nReg, nValue };
-   I2cSend(g_pI2cAddress[nModule], pbData, 2);
+   WriteRegister(nModule, nReg, &nValue, sizeof(nValue));
 }
 //-----------< FUNCTION: SX1509Get16 >---------------------------------------
 // Purpose:    reads a 16-bit register
@@ -163,7 +199,7 @@ VOID SX1509Set8 (UI8 nModule, UI8 nReg, UI8 nValue)
 UI16 SX1509Get16 (UI8 nModule, UI8 nReg)
 {
    BYTE pbData[2] = { 0, };
-   I2cSendRecv(g_pI2cAddress[nModule], &nReg, 1, pbData, sizeof(pbData));
+   ReadRegister(nModule, nReg, pbData, sizeof(pbData));
    return 
       ((UI16)pbData[0] << 8) | 
       (      pbData[1] << 0);
@@ -176,8 +212,8 @@ UI16 SX1509Get16 (UI8 nModule, UI8 nReg)
 //---------------------------------------------------------------------------
 VOID SX1509Set16 (UI8 nModule, UI8 nReg, UI16 nValue)
 {
-   BYTE pbData[3] = { nReg, (nValue >> 8), (nValue >> 0) };
-   I2cSend(g_pI2cAddress[nModule], pbData, sizeof(pbData));
+   BYTE pbData[2] = { (nValue >> 8), (nValue >> 0) };
+   WriteRegister(nModule, nReg, pbData, sizeof(pbData));
 }
 //-----------< FUNCTION: SX1509Get32 >---------------------------------------
 // Purpose:    reads a 32-bit register
@@ -188,7 +224,7 @@ VOID SX1509Set16 (UI8 nModule, UI8 nReg, UI16 nValue)
 UI32 SX1509Get32 (UI8 nModule, UI8 nReg)
 {
    BYTE pbData[4] = { 0, };
-   I2cSendRecv(g_pI2cAddress[nModule], &nReg, 1, pbData, sizeof(pbData));
+   ReadRegister(nModule, nReg, pbData, sizeof(pbData));
    return 
       ((UI32)pbData[0] << 24) | 
       ((UI32)pbData[1] << 16) | 
@@ -205,13 +241,12 @@ VOID SX1509Set32 (UI8 nModule, UI8 nReg, UI32 nValue)
 {
    BYTE pbData[] =
    { 
-      nReg, 
       (nValue >> 24), 
       (nValue >> 16), 
       (nValue >>  8), 
       (nValue >>  0) 
    };
-   I2cSend(g_pI2cAddress[nModule], pbData, sizeof(pbData));
+   WriteRegister(nModule, nReg, pbData, sizeof(pbData));
 }
 //-----------< FUNCTION: SX1509GetKeyData >----------------------------------
 // Purpose:    reads the keyboard data register to determine the key pressed
@@ -348,9 +383,9 @@ SX1509_PWM_CONFIG SX1509GetPwmConfig (UI8 nModule, UI8 nIo)
 {
    BYTE pbData[5] = { 0, };
    if (g_pnTRiseRegs[nIo] != SX1509_REG_INVALID)
-      I2cSendRecv(g_pI2cAddress[nModule], &g_pnTOnRegs[nIo], 1, pbData, 5);
+      ReadRegister(nModule, g_pnTOnRegs[nIo], pbData, 5);
    else
-      I2cSendRecv(g_pI2cAddress[nModule], &g_pnTOnRegs[nIo], 1, pbData, 3);
+      ReadRegister(nModule, g_pnTOnRegs[nIo], pbData, 3);
    return (SX1509_PWM_CONFIG)
    {
       .nOnTime       = pbData[0],
@@ -370,9 +405,8 @@ SX1509_PWM_CONFIG SX1509GetPwmConfig (UI8 nModule, UI8 nIo)
 //---------------------------------------------------------------------------
 VOID SX1509SetPwmConfig (UI8 nModule, UI8 nIo, SX1509_PWM_CONFIG config)
 {
-   BYTE pbData[6] = 
+   BYTE pbData[5] =
    {
-      g_pnTOnRegs[nIo],
       config.nOnTime,
       config.nOnIntensity,
       (config.nOffTime << 3) | (config.nOffIntensity & 0x07),
@@ -380,9 +414,9 @@ VOID SX1509SetPwmConfig (UI8 nModule, UI8 nIo, SX1509_PWM_CONFIG config)
       config.nFadeOutTime
    };
    if (g_pnTRiseRegs[nIo] != SX1509_REG_INVALID)
-      I2cSend(g_pI2cAddress[nModule], pbData, 6);
+      WriteRegister(nModule, g_pnTOnRegs[nIo], pbData, 5);
    else
-      I2cSend(g_pI2cAddress[nModule], pbData, 4);
+      WriteRegister(nModule, g_pnTOnRegs[nIo], pbData, 3);
 }
 //-----------< FUNCTION: SX1509Reset >---------------------------------------
 // Purpose:    resets the SX1509 to default register values
@@ -0,0 +1,117 @@
+//===========================================================================
+// Module:  trace.c
+// Purpose: AVR deferred binary trace log
+//
+// Copyright © 2013
+// Brent M. Spell. All rights reserved.
+//
+// This library is free software; you can redistribute it and/or modify it 
+// under the terms of the GNU Lesser General Public License as published 
+// by the Free Software Foundation; either version 3 of the License, or 
+// (at your option) any later version. This library is distributed in the 
+// hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+// See the GNU Lesser General Public License for more details. You should 
+// have received a copy of the GNU Lesser General Public License along with 
+// this library; if not, write to 
+//    Free Software Foundation, Inc. 
+//    51 Franklin Street, Fifth Floor 
+//    Boston, MA 02110-1301 USA
+//===========================================================================
+//-------------------[       Pre Include Defines       ]-------------------//
+//-------------------[      Library Include Files      ]-------------------//
+//-------------------[      Project Include Files      ]-------------------//
+#include "trace.h"
+#include "fifo.h"
+#include "uart.h"
+//-------------------[       Module Definitions        ]-------------------//
+// largest record, a 4-byte header and TRACE_ARGS_MAX 32-bit arguments
+#define TRACE_RECORD_MAX               (4 + TRACE_ARGS_MAX * 4)
+#if TRACE_RECORD_MAX >= TRACE_BUFFER_SIZE
+#  error TRACE_BUFFER_SIZE is too small for the largest trace record
+#endif
+//-------------------[        Module Variables         ]-------------------//
+//-------------------[        Module Prototypes        ]-------------------//
+//-------------------[         Implementation          ]-------------------//
+// trace record buffer
+// . each record is stored as a length byte, followed by the record
+// . any context (main loop or ISR) produces records atomically, and
+//   the main loop consumes them in TraceFlush
+DECLARE_RING(g_pTraceRing, TRACE_BUFFER_SIZE);
+// records dropped since the last buffered record
+static UI16 g_nDropped = 0;
+//-----------< FUNCTION: TraceWrite >----------------------------------------
+// Purpose:    buffers a trace record, or drops it if the buffer is full
+//             this is called by the TraceLog macro
+// Parameters: pvRecord - the record to buffer, starting with a header
+//             cbRecord - the size of the record
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID TraceWrite (PCVOID pvRecord, UI8 cbRecord)
+{
+   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+   {
+      UI8 cbFree = RingSize(g_pTraceRing) - RingCount(g_pTraceRing);
+      // report any dropped records ahead of this one, to keep the
+      // drop marker in sequence
+      if (g_nDropped != 0)
+      {
+         struct __attribute__((packed))
+         {
+            TRACE_HEADER   Header;
+            UI16           nDropped;
+         } Dropped = { { TRACE_ID_DROPPED, TRACE_CLOCK }, g_nDropped };
+         if (cbFree < 1 + sizeof(Dropped) + 1 + cbRecord)
+         {
+            g_nDropped++;
+            return;
+         }
+         RingWrite(g_pTraceRing, sizeof(Dropped));
+         RingWriteBlock(g_pTraceRing, &Dropped, sizeof(Dropped));
+         g_nDropped = 0;
+      }
+      else if (cbFree < 1 + cbRecord)
+      {
+         g_nDropped++;
+         return;
+      }
+      RingWrite(g_pTraceRing, cbRecord);
+      RingWriteBlock(g_pTraceRing, pvRecord, cbRecord);
+   }
+}
+//-----------< FUNCTION: TraceFlush >----------------------------------------
+// Purpose:    sends the oldest buffered trace record over UART, if there
+//             is room for it in the UART send buffer
+//             this should be called from the main loop's idle time
+// Parameters: none
+// Returns:    TRUE if a record was sent
+//             FALSE if there was nothing to send or no room to send it
+//---------------------------------------------------------------------------
+BOOL TraceFlush ()
+{
+   BYTE pbRecord[TRACE_RECORD_MAX];
+   UI8  cbRecord = 0;
+   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+   {
+      if (!RingIsEmpty(g_pTraceRing))
+      {
+         // only take the record if its frame will not block in UartSend,
+         // unless the frame is larger than the whole send buffer
+         UI8 cbPeek = g_pTraceRing->pbBuffer[
+            g_pTraceRing->nTail & g_pTraceRing->cbMask
+         ];
+         UI8 cbFrame = 1 + cbPeek + UART_FRAME_OVERHEAD(cbPeek);
+         UI8 cbQueued = UartSendReady();
+         if (UART_SEND_BUFFER_SIZE - cbQueued >= cbFrame || cbQueued == 0)
+         {
+            cbRecord = RingRead(g_pTraceRing);
+            RingReadBlock(g_pTraceRing, pbRecord, cbRecord);
+         }
+      }
+   }
+   if (cbRecord == 0)
+      return FALSE;
+   UartSendByte(UART_FRAME_DELIM);
+   UartSendFrame(pbRecord, cbRecord);
+   return TRUE;
+}
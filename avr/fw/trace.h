@@ -0,0 +1,119 @@
+//===========================================================================
+// Module:  trace.h
+// Purpose: AVR deferred binary trace log
+//
+// Copyright © 2013
+// Brent M. Spell. All rights reserved.
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version. This library is distributed in the
+// hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Lesser General Public License for more details. You should
+// have received a copy of the GNU Lesser General Public License along with
+// this library; if not, write to
+//    Free Software Foundation, Inc.
+//    51 Franklin Street, Fifth Floor
+//    Boston, MA 02110-1301 USA
+//===========================================================================
+#ifndef __TRACE_H
+#define __TRACE_H
+//-------------------[       Pre Include Defines       ]-------------------//
+//-------------------[      Library Include Files      ]-------------------//
+//-------------------[      Project Include Files      ]-------------------//
+#ifndef __AVRDEFS_H
+#include "avrdefs.h"
+#endif
+//-------------------[       Module Definitions        ]-------------------//
+//===========================================================================
+// TRACE CONFIGURATION
+// . TRACE_BUFFER_SIZE     trace record buffer size (power of 2, up to 128)
+// . TRACE_CLOCK           timestamp expression (16-bit), such as a
+//                         timer counter register
+//===========================================================================
+#ifndef TRACE_BUFFER_SIZE
+#  define TRACE_BUFFER_SIZE            (64)
+#endif
+#ifndef TRACE_CLOCK
+#  define TRACE_CLOCK                  TCNT1
+#endif
+//===========================================================================
+// TRACE RECORDS
+// . each TraceLog call site stores its format string and argument sizes
+//   in the .trace ELF section, which is not loaded into flash, and its
+//   offset in that section is the message ID
+// . at run time, only the message ID, the timestamp and the raw argument
+//   values are copied into the trace buffer, so tracing is cheap enough
+//   for ISRs and flight builds
+// . TraceFlush sends one buffered record per call as a UART frame,
+//   preceded by a frame delimiter to resynchronize after text output
+// . the host decoder (linux/tracedump) looks up each message ID in the
+//   ELF image and formats the record
+// . arguments are integers, floats, or pointers to constant strings (%s,
+//   decoded from the .data image in the ELF), up to TRACE_ARGS_MAX
+// . records that do not fit in the buffer are dropped and counted, and
+//   the count is reported in a TRACE_ID_DROPPED record
+//===========================================================================
+#define TRACE_ARGS_MAX                 (8)      // maximum TraceLog arguments
+#define TRACE_ID_DROPPED               (0xFFFF) // dropped records message ID
+// record header
+typedef struct __attribute__((packed)) tagTraceHeader
+{
+   UI16  nId;                          // message ID
+   UI16  nTime;                        // TRACE_CLOCK timestamp
+} TRACE_HEADER;
+// trace section attributes
+// . the ';' comments out the section flags appended by the compiler,
+//   so that the section is not allocated in the image
+#define TRACE_SECTION                                                      \
+   __attribute__((section(".trace,\"\",@progbits ;"), used, aligned(1)))
+//===========================================================================
+// TRACE INTERFACE
+//===========================================================================
+VOID     TraceWrite  (PCVOID pvRecord, UI8 cbRecord);
+BOOL     TraceFlush  ();
+// trace logging
+#define TraceLog(fmt, ...)                                                 \
+   do                                                                      \
+   {                                                                       \
+      static const struct                                                  \
+      {                                                                    \
+         UI8   cArgs;                                                      \
+         UI8   pcbArgs[__TraceArgc(__VA_ARGS__)];                          \
+         CHAR  szFormat[sizeof(fmt)];                                      \
+      } __TraceEntry TRACE_SECTION =                                       \
+         { __TraceArgc(__VA_ARGS__),                                       \
+           { __TraceEach(__TraceSize, ##__VA_ARGS__) }, fmt };             \
+      struct __attribute__((packed))                                       \
+      {                                                                    \
+         TRACE_HEADER Header;                                              \
+         __TraceEach(__TraceField, ##__VA_ARGS__)                          \
+      } __TraceRecord =                                                    \
+         { { (UI16)&__TraceEntry, TRACE_CLOCK }, ##__VA_ARGS__ };          \
+      TraceWrite(&__TraceRecord, sizeof(__TraceRecord));                   \
+   } while (0)
+// argument list helpers
+// . arguments are stored as their promoted type, so that strings decay
+//   to pointers
+#define __TraceArgc(...)                                                   \
+   __TraceArgcN(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define __TraceArgcN(_, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define __TraceType(a)                 __typeof__((a) + 0)
+#define __TraceSize(n, a)              sizeof(__TraceType(a)),
+#define __TraceField(n, a)             __TraceType(a) _##n;
+#define __TraceEach(m, ...)                                                \
+   __TraceEachN(__TraceArgc(__VA_ARGS__), m, ##__VA_ARGS__)
+#define __TraceEachN(n, m, ...)        __TraceEachX(n, m, ##__VA_ARGS__)
+#define __TraceEachX(n, m, ...)        __TraceEach##n(m, ##__VA_ARGS__)
+#define __TraceEach0(m, ...)
+#define __TraceEach1(m, a)             m(1, a)
+#define __TraceEach2(m, a, ...)        m(2, a) __TraceEach1(m, __VA_ARGS__)
+#define __TraceEach3(m, a, ...)        m(3, a) __TraceEach2(m, __VA_ARGS__)
+#define __TraceEach4(m, a, ...)        m(4, a) __TraceEach3(m, __VA_ARGS__)
+#define __TraceEach5(m, a, ...)        m(5, a) __TraceEach4(m, __VA_ARGS__)
+#define __TraceEach6(m, a, ...)        m(6, a) __TraceEach5(m, __VA_ARGS__)
+#define __TraceEach7(m, a, ...)        m(7, a) __TraceEach6(m, __VA_ARGS__)
+#define __TraceEach8(m, a, ...)        m(8, a) __TraceEach7(m, __VA_ARGS__)
+#endif // __TRACE_H
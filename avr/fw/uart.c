@@ -20,19 +20,119 @@
 //===========================================================================
 //-------------------[       Pre Include Defines       ]-------------------//
 //-------------------[      Library Include Files      ]-------------------//
+#include <util/crc16.h>
 //-------------------[      Project Include Files      ]-------------------//
 #include "uart.h"
 #include "fifo.h"
 //-------------------[       Module Definitions        ]-------------------//
+#if UART_RECV_IDLE
+// idle timer registers
+#  if UART_RECV_IDLE_TIMER == 0
+#     define UART_IDLE_TCCRA        TCCR0A
+#     define UART_IDLE_TCCRB        TCCR0B
+#     define UART_IDLE_TCNT         TCNT0
+#     define UART_IDLE_OCRA         OCR0A
+#     define UART_IDLE_TIFR         TIFR0
+#     define UART_IDLE_TIMSK        TIMSK0
+#     define UART_IDLE_WGM          WGM01
+#     define UART_IDLE_OCFA         OCF0A
+#     define UART_IDLE_OCIEA        OCIE0A
+#     define UART_IDLE_vect         TIMER0_COMPA_vect
+#     define UartIdleScale(x)       AvrClk0Scale(x)
+#  elif UART_RECV_IDLE_TIMER == 2
+#     define UART_IDLE_TCCRA        TCCR2A
+#     define UART_IDLE_TCCRB        TCCR2B
+#     define UART_IDLE_TCNT         TCNT2
+#     define UART_IDLE_OCRA         OCR2A
+#     define UART_IDLE_TIFR         TIFR2
+#     define UART_IDLE_TIMSK        TIMSK2
+#     define UART_IDLE_WGM          WGM21
+#     define UART_IDLE_OCFA         OCF2A
+#     define UART_IDLE_OCIEA        OCIE2A
+#     define UART_IDLE_vect         TIMER2_COMPA_vect
+#     define UartIdleScale(x)       AvrClk2Scale(x)
+#  else
+#     error UART_RECV_IDLE_TIMER must be 0 or 2
+#  endif
+// idle timeout, in CPU cycles (10 bits per 8N1 character),
+// and the smallest prescaler that fits it in 8 bits
+#  define UART_IDLE_CYCLES          (F_CPU * 10UL * UART_RECV_IDLE / UART_BAUD)
+#  if UART_IDLE_CYCLES <= 256UL * 8
+#     define UART_IDLE_PRESCALE     (8)
+#  elif UART_IDLE_CYCLES <= 256UL * 64
+#     define UART_IDLE_PRESCALE     (64)
+#  elif UART_IDLE_CYCLES <= 256UL * 256
+#     define UART_IDLE_PRESCALE     (256)
+#  elif UART_IDLE_CYCLES <= 256UL * 1024
+#     define UART_IDLE_PRESCALE     (1024)
+#  else
+#     error UART_RECV_IDLE is too long for an 8-bit timer
+#  endif
+#endif
 //-------------------[        Module Variables         ]-------------------//
 //-------------------[        Module Prototypes        ]-------------------//
+static int UartStreamPut (char ch, FILE* pStream);
+static VOID Usart0StartSend ();
+static UI8 UartQueue (UART_HANDLE hUart, PCBYTE pbData, UI8 cbData);
+#if UART_FRAME
+static VOID UartFrameRecv (BYTE bRecv);
+static VOID UartFrameAppend (BYTE b);
+#endif
+#if UART_PRINTF_MINI
+static VOID UartFormat (PCSTR psz, BOOL fProgmem, va_list args);
+static VOID UartFormatNumber (
+   UI32  nValue,
+   UI8   nBase,
+   BOOL  fUpper,
+   BOOL  fNegative,
+   UI8   cchPad,
+   BOOL  fZero);
+static inline CHAR UartFormatChar (PCSTR psz, BOOL fProgmem);
+#endif
 //-------------------[         Implementation          ]-------------------//
-// send/receive queues
-DECLARE_FIFO(g_pSendFifo, UART_SEND_BUFFER_SIZE);
-DECLARE_FIFO(g_pRecvFifo, UART_RECV_BUFFER_SIZE);
+// USART0 port
+// . the main loop produces into the send ring and the UDRE ISR consumes it
+// . the RX ISR produces into the receive ring and the main loop consumes it
+DECLARE_UART_POLICY(
+   g_hUsart0,
+   UART_SEND_BUFFER_SIZE, UART_SEND_POLICY,
+   UART_RECV_BUFFER_SIZE, UART_RECV_POLICY,
+   Usart0StartSend
+);
+// formatted output stream
+// . stdio writes each character straight into the send ring as it
+//   is produced, so no intermediate format buffer is needed
+static FILE g_UartStream = FDEV_SETUP_STREAM(
+   UartStreamPut,
+   NULL,
+   _FDEV_SETUP_WRITE
+);
 // callback functions
-static UART_CALLBACK g_pfnOnSend = NULL;
-static UART_CALLBACK g_pfnOnRecv = NULL;
+static UART_EVENT_CALLBACK g_pfnOnSendIdle = NULL;
+#if UART_RECV_IDLE
+static UART_BURST_CALLBACK g_pfnOnRecvBurst = NULL;
+#endif
+// asynchronous send state
+// . the caller's buffer is sent directly by the UDRE ISR once the send
+//   ring has drained, so it must remain valid until pfnOnSent is called
+// . the pending count is published last by the main loop and cleared by
+//   the ISR, so it hands ownership of the buffer back and forth
+static PCBYTE volatile g_pbPending = NULL;
+static PCVOID volatile g_pvPending = NULL;
+static volatile UI8 g_cbPending = 0;
+static UART_SEND_CALLBACK volatile g_pfnOnSent = NULL;
+#if UART_FRAME
+// frame receive state
+// . the receive ISR decodes COBS blocks directly into the frame buffer,
+//   which holds the payload and its CRC
+static UART_FRAME_CALLBACK g_pfnOnFrame = NULL;
+static BYTE g_pbFrame[UART_FRAME_SIZE + 2];
+static UI8  g_cbFrame = 0;                   // decoded frame length
+static UI8  g_cbBlock = 0;                   // bytes left in the COBS block
+static BOOL g_fBlockZero = FALSE;            // block ends with a zero byte
+static BOOL g_fFrameError = FALSE;           // frame overflowed the buffer
+static UI16 g_nFrameCrc = 0xFFFF;            // running frame CRC
+#endif
 //-----------< FUNCTION: UartInit >------------------------------------------
 // Purpose:    UART interface initialization
 // Parameters: pConfig - configuration structure
@@ -40,17 +140,26 @@ static UART_CALLBACK g_pfnOnRecv = NULL;
 //---------------------------------------------------------------------------
 VOID UartInit (PUART_CONFIG pConfig)
 {
-   g_pfnOnSend = pConfig->pfnOnSend;
-   g_pfnOnRecv = pConfig->pfnOnRecv;
-#if (UART_BAUD_2X)                                  // set base baud rate
-   UBRR0  = (UI16)((double)F_CPU / ((double)UART_BAUD * 8) - 1);
-#else
-   UBRR0  = (UI16)((double)F_CPU / ((double)UART_BAUD * 16) - 1);
+   g_hUsart0->pfnOnSend = pConfig->pfnOnSend;
+   g_hUsart0->pfnOnRecv = pConfig->pfnOnRecv;
+   g_pfnOnSendIdle = pConfig->pfnOnSendIdle;
+#if UART_FRAME
+   g_pfnOnFrame = pConfig->pfnOnFrame;
 #endif
+#if UART_RECV_IDLE
+   g_pfnOnRecvBurst = pConfig->pfnOnRecvBurst;
+   // 8-bit idle timer, restarted on each received byte
+   UART_IDLE_TCCRA = BitMask(UART_IDLE_WGM);          // CTC mode
+   UART_IDLE_TCCRB = UartIdleScale(UART_IDLE_PRESCALE);// set prescaler
+   UART_IDLE_OCRA  = UART_IDLE_CYCLES / UART_IDLE_PRESCALE - 1;
+#endif
+   UBRR0  = UART_UBRR;                                // set base baud rate
    UCSR0A = (UART_BAUD_2X << U2X0);                   // set 2x multiplier
    UCSR0B = (UART_SEND << TXEN0) |                    // enable TX
             (UART_RECV << RXEN0) |                    // enable RX
             (UART_RECV << RXCIE0);                    // enable RX interrupt
+   if (UART_SEND && g_pfnOnSendIdle != NULL)          // enable TXC interrupt
+      RegSetHi(UCSR0B, TXCIE0);
    UCSR0C = (3<<UCSZ00) |                             // set 8 data bits
             (0<<USBS0) |                              // set 1 stop bit
             (0<<UPM00) | (0<<UPM01);                  // set 0 parity bits
@@ -62,7 +171,7 @@ VOID UartInit (PUART_CONFIG pConfig)
 //---------------------------------------------------------------------------
 UI8 UartSendReady ()
 {
-   return FifoCount(g_pSendFifo);
+   return UartPortSendReady(g_hUsart0);
 }
 //-----------< FUNCTION: UartSend >------------------------------------------
 // Purpose:    sends a message on the UART interface
@@ -72,27 +181,172 @@ UI8 UartSendReady ()
 //---------------------------------------------------------------------------
 VOID UartSend (PCVOID pvData, UI8 cbData)
 {
-   // transfer the entire buffer, spinning when the FIFO becomes full
+   // an asynchronous send in progress holds the ring, to keep the
+   // output ordered, so wait for it or drop the message by policy
+#if UART_SEND_POLICY == FIFO_POLICY_DROP
+   if (g_cbPending != 0)
+      return;
+#else
+   while (g_cbPending != 0)
+      ;
+#endif
+   UartPortSend(g_hUsart0, pvData, cbData);
+}
+//-----------< FUNCTION: UartTrySend >---------------------------------------
+// Purpose:    queues as much of a message as fits, without waiting
+// Parameters: pbData - the message to send
+//             cbData - the number of bytes to send
+// Returns:    the number of bytes accepted, which is 0 while an
+//             asynchronous send is in progress
+//---------------------------------------------------------------------------
+UI8 UartTrySend (PCVOID pvData, UI8 cbData)
+{
+   if (g_cbPending != 0)
+      return 0;
+   return UartPortTrySend(g_hUsart0, pvData, cbData);
+}
+//-----------< FUNCTION: UartBeginSend >-------------------------------------
+// Purpose:    starts an asynchronous send from a caller-owned buffer
+// Parameters: pvData    - the message to send, which must remain valid
+//                         until the completion callback
+//             cbData    - the number of bytes to send
+//             pfnOnSent - completion callback (optional), called from the
+//                         UDRE ISR once the last byte has been handed to
+//                         the transmitter
+// Returns:    TRUE if the send was started
+//             FALSE if another asynchronous send is in progress
+//---------------------------------------------------------------------------
+BOOL UartBeginSend (PCVOID pvData, UI8 cbData, UART_SEND_CALLBACK pfnOnSent)
+{
+   if (g_cbPending != 0)
+      return FALSE;
+   if (cbData == 0)
+   {
+      if (pfnOnSent != NULL)
+         pfnOnSent(pvData);
+      return TRUE;
+   }
+   g_pbPending = (PCBYTE)pvData;
+   g_pvPending = pvData;
+   g_pfnOnSent = pfnOnSent;
+   g_cbPending = cbData;
+   RegSetHi(UCSR0B, UDRIE0);
+   return TRUE;
+}
+//-----------< FUNCTION: UartIsSendBusy >------------------------------------
+// Purpose:    determines whether an asynchronous send is in progress
+// Parameters: none
+// Returns:    TRUE if an asynchronous send is in progress
+//             FALSE otherwise
+//---------------------------------------------------------------------------
+BOOL UartIsSendBusy ()
+{
+   return g_cbPending != 0;
+}
+//-----------< FUNCTION: UartGetHandle >-------------------------------------
+// Purpose:    retrieves the USART0 port handle, for the port API
+// Parameters: none
+// Returns:    the USART0 port handle
+//---------------------------------------------------------------------------
+UART_HANDLE UartGetHandle ()
+{
+   return g_hUsart0;
+}
+//-----------< FUNCTION: UartPortSendReady >---------------------------------
+// Purpose:    retrieves the number of bytes waiting to be sent on a port
+// Parameters: hUart - the port handle
+// Returns:    the number of bytes in the send ring
+//---------------------------------------------------------------------------
+UI8 UartPortSendReady (UART_HANDLE hUart)
+{
+   return RingCount(hUart->pSendRing);
+}
+//-----------< FUNCTION: UartPortSend >--------------------------------------
+// Purpose:    sends a message on a port
+// Parameters: hUart  - the port handle
+//             pbData - the message to send
+//             cbData - the number of bytes to send
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID UartPortSend (UART_HANDLE hUart, PCVOID pvData, UI8 cbData)
+{
+   // queue as much as possible, applying the send overflow policy
+   // . starting the back end after each fill restarts the transfer
+   //   if the ISR had drained the ring and disabled itself
    PCBYTE pbData = (PCBYTE)pvData;
-   while (cbData > 0)
+   UI8    cbSent = RingWriteBlock(hUart->pSendRing, pbData, cbData);
+   hUart->pfnStartSend();
+   // under the reject policy, spin until the remainder has been queued
+   // . the overflow was counted once above, so fill the free spans
+   //   directly instead of retrying the block write
+   while (cbSent < cbData)
+      cbSent += UartQueue(hUart, pbData + cbSent, cbData - cbSent);
+}
+//-----------< FUNCTION: UartPortTrySend >-----------------------------------
+// Purpose:    queues as much of a message as fits on a port, without
+//             waiting
+// Parameters: hUart  - the port handle
+//             pbData - the message to send
+//             cbData - the number of bytes to send
+// Returns:    the number of bytes accepted
+//---------------------------------------------------------------------------
+UI8 UartPortTrySend (UART_HANDLE hUart, PCVOID pvData, UI8 cbData)
+{
+   return UartQueue(hUart, (PCBYTE)pvData, cbData);
+}
+//-----------< FUNCTION: UartPortRecvReady >---------------------------------
+// Purpose:    retrieves the number of bytes received on a port
+// Parameters: hUart - the port handle
+// Returns:    the number of bytes in the receive ring
+//---------------------------------------------------------------------------
+UI8 UartPortRecvReady (UART_HANDLE hUart)
+{
+   return RingCount(hUart->pRecvRing);
+}
+//-----------< FUNCTION: UartPortRecv >--------------------------------------
+// Purpose:    receives data from a port
+// Parameters: hUart  - the port handle
+//             pvData - the receive buffer
+//             cbData - the size of the receive buffer
+// Returns:    the number of bytes received
+//---------------------------------------------------------------------------
+UI8 UartPortRecv (UART_HANDLE hUart, PVOID pvData, UI8 cbData)
+{
+   return RingReadBlock(hUart->pRecvRing, pvData, cbData);
+}
+//-----------< FUNCTION: UartQueue >-----------------------------------------
+// Purpose:    copies a message into the free space in a port's send ring
+// Parameters: hUart  - the port handle
+//             pbData - the message to send
+//             cbData - the number of bytes to send
+// Returns:    the number of bytes queued
+//---------------------------------------------------------------------------
+static UI8 UartQueue (UART_HANDLE hUart, PCBYTE pbData, UI8 cbData)
+{
+   UI8 cbSent = 0;
+   while (cbSent < cbData)
    {
-      UI8 cbSent = 0;
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-      {
-         BOOL bStart = !RegGet(UCSR0B, UDRIE0);
-         // fill the send FIFO
-         cbSent = Min(cbData, FifoSize(g_pSendFifo) - FifoCount(g_pSendFifo));
-         FifoWriteBlock(g_pSendFifo, pbData, cbSent);
-         // if the FIFO was empty, start the UART transfer
-         if (cbSent > 0 && bStart)
-         {
-            UDR0 = FifoRead(g_pSendFifo);
-            RegSetHi(UCSR0B, UDRIE0);
-         }
-      }
-      pbData += cbSent;
-      cbData -= cbSent;
+      UI8   cbSpan = 0;
+      PBYTE pbSpan = RingReserveSpan(hUart->pSendRing, &cbSpan);
+      if ((cbSpan = Min(cbSpan, cbData - cbSent)) == 0)
+         break;
+      memcpy(pbSpan, pbData + cbSent, cbSpan);
+      RingCommitWrite(hUart->pSendRing, cbSpan);
+      cbSent += cbSpan;
    }
+   if (cbSent > 0)
+      hUart->pfnStartSend();
+   return cbSent;
+}
+//-----------< FUNCTION: Usart0StartSend >-----------------------------------
+// Purpose:    starts the USART0 transmitter, by enabling the UDRE
+//             interrupt
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID Usart0StartSend ()
+{
+   RegSetHi(UCSR0B, UDRIE0);
 }
 //-----------< FUNCTION: UartSendDelim >-------------------------------------
 // Purpose:    sends a message, terminated with a delimiter
@@ -125,11 +379,36 @@ VOID UartSendStr (PCSTR psz, ...)
 //---------------------------------------------------------------------------
 VOID UartSendStrV (PCSTR psz, va_list args)
 {
-   UI8 cchBuffer = vsnprintf(NULL, 0, psz, args);
-   CHAR szBuffer[cchBuffer + 1];
-   vsnprintf(szBuffer, cchBuffer + 1, psz, args);
-   szBuffer[cchBuffer] = '\0';
-   UartSend(szBuffer, cchBuffer);
+#if UART_PRINTF_MINI
+   UartFormat(psz, FALSE, args);
+#else
+   vfprintf(&g_UartStream, psz, args);
+#endif
+}
+//-----------< FUNCTION: UartSendStr_P >-------------------------------------
+// Purpose:    sends a formatted string over UART
+// Parameters: psz - the format string, in program memory
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID UartSendStr_P (PCSTR psz, ...)
+{
+   va_list args; va_start(args, psz);
+   UartSendStrV_P(psz, args);
+   va_end(args);
+}
+//-----------< FUNCTION: UartSendStrV_P >------------------------------------
+// Purpose:    sends a formatted string over UART
+// Parameters: psz  - the format string, in program memory
+//             args - variable format string arguments
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID UartSendStrV_P (PCSTR psz, va_list args)
+{
+#if UART_PRINTF_MINI
+   UartFormat(psz, TRUE, args);
+#else
+   vfprintf_P(&g_UartStream, psz, args);
+#endif
 }
 //-----------< FUNCTION: UartSendLine >--------------------------------------
 // Purpose:    sends a formatted, line-terminated string over UART
@@ -150,11 +429,253 @@ VOID UartSendLine (PCSTR psz, ...)
 //---------------------------------------------------------------------------
 VOID UartSendLineV (PCSTR psz, va_list args)
 {
-   UI8 cchBuffer = vsnprintf(NULL, 0, psz, args);
-   CHAR szBuffer[cchBuffer + 1];
-   vsnprintf(szBuffer, cchBuffer + 1, psz, args);
-   szBuffer[cchBuffer] = '\0';
-   UartSendDelim(szBuffer, cchBuffer, '\n');
+   UartSendStrV(psz, args);
+   UartSendChar('\n');
+}
+//-----------< FUNCTION: UartSendLine_P >------------------------------------
+// Purpose:    sends a formatted, line-terminated string over UART
+// Parameters: psz - the format string, in program memory
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID UartSendLine_P (PCSTR psz, ...)
+{
+   va_list args; va_start(args, psz);
+   UartSendLineV_P(psz, args);
+   va_end(args);
+}
+//-----------< FUNCTION: UartSendLineV_P >-----------------------------------
+// Purpose:    sends a formatted, line-terminated string over UART
+// Parameters: psz  - the format string, in program memory
+//             args - variable format string arguments
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID UartSendLineV_P (PCSTR psz, va_list args)
+{
+   UartSendStrV_P(psz, args);
+   UartSendChar('\n');
+}
+//-----------< FUNCTION: UartGetStream >-------------------------------------
+// Purpose:    retrieves the UART stdio output stream
+// Parameters: none
+// Returns:    a write-only stream that queues characters for sending
+//---------------------------------------------------------------------------
+FILE* UartGetStream ()
+{
+   return &g_UartStream;
+}
+//-----------< FUNCTION: UartStreamPut >-------------------------------------
+// Purpose:    stdio stream output handler
+// Parameters: ch      - the character to send
+//             pStream - the UART stream
+// Returns:    zero
+//---------------------------------------------------------------------------
+static int UartStreamPut (char ch, FILE* pStream)
+{
+   IgnoreParam(pStream);
+   UartSendChar(ch);
+   return 0;
+}
+#if UART_PRINTF_MINI
+//-----------< FUNCTION: UartFormatChar >------------------------------------
+// Purpose:    reads a format string character
+// Parameters: psz      - the format string position to read
+//             fProgmem - TRUE if psz is in program memory, FALSE otherwise
+// Returns:    the character at psz
+//---------------------------------------------------------------------------
+static inline CHAR UartFormatChar (PCSTR psz, BOOL fProgmem)
+{
+   return fProgmem ? pgm_read_byte(psz) : *psz;
+}
+//-----------< FUNCTION: UartFormat >----------------------------------------
+// Purpose:    compact, integer-only formatter
+//             . supports %c, %s, %S (program memory string), %d, %i, %u,
+//               %x, %X and %%, with an optional 0 flag, width and l size
+//             . characters are queued as they are produced
+// Parameters: psz      - the format string
+//             fProgmem - TRUE if psz is in program memory, FALSE otherwise
+//             args     - variable format string arguments
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID UartFormat (PCSTR psz, BOOL fProgmem, va_list args)
+{
+   for ( ; ; )
+   {
+      CHAR ch = UartFormatChar(psz++, fProgmem);
+      if (ch == '\0')
+         break;
+      if (ch != '%')
+      {
+         UartSendChar(ch);
+         continue;
+      }
+      // parse the flags, width and size
+      BOOL fZero   = FALSE;
+      BOOL fLong   = FALSE;
+      UI8  cchPad  = 0;
+      if ((ch = UartFormatChar(psz++, fProgmem)) == '0')
+      {
+         fZero = TRUE;
+         ch = UartFormatChar(psz++, fProgmem);
+      }
+      for ( ; ch >= '0' && ch <= '9'; ch = UartFormatChar(psz++, fProgmem))
+         cchPad = cchPad * 10 + (ch - '0');
+      if (ch == 'l')
+      {
+         fLong = TRUE;
+         ch = UartFormatChar(psz++, fProgmem);
+      }
+      // format the argument
+      // . integers follow the avr-libc convention of 16-bit default
+      //   arguments and 32-bit long arguments, regardless of -mint8
+      switch (ch)
+      {
+         case '\0':
+            return;
+         case 'c':
+            UartSendChar((CHAR)va_arg(args, int));
+            break;
+         case 's':
+         case 'S':
+         {
+            PCSTR pszArg = va_arg(args, PCSTR);
+            BSIZE cchArg = (ch == 's') ? strlen(pszArg) : strlen_P(pszArg);
+            for ( ; cchPad > cchArg; cchPad--)
+               UartSendChar(' ');
+            if (ch == 's')
+            {
+               // UartSend takes at most 255 bytes per call
+               for ( ; cchArg > 0xFF; cchArg -= 0xFF, pszArg += 0xFF)
+                  UartSend(pszArg, 0xFF);
+               UartSend(pszArg, cchArg);
+            }
+            else
+               for ( ; cchArg > 0; cchArg--)
+                  UartSendChar(pgm_read_byte(pszArg++));
+            break;
+         }
+         case 'd':
+         case 'i':
+         {
+            I32  nArg = fLong ? va_arg(args, I32) : va_arg(args, I16);
+            UI32 nAbs = (nArg < 0) ? -(UI32)nArg : (UI32)nArg;
+            UartFormatNumber(nAbs, 10, FALSE, nArg < 0, cchPad, fZero);
+            break;
+         }
+         case 'u':
+         case 'x':
+         case 'X':
+         {
+            UI32 nArg = fLong ? va_arg(args, UI32) : va_arg(args, UI16);
+            UI8  nBase = (ch == 'u') ? 10 : 16;
+            UartFormatNumber(nArg, nBase, ch == 'X', FALSE, cchPad, fZero);
+            break;
+         }
+         default:
+            UartSendChar(ch);
+            break;
+      }
+   }
+}
+//-----------< FUNCTION: UartFormatNumber >----------------------------------
+// Purpose:    formats an integer value
+// Parameters: nValue    - the absolute value to format
+//             nBase     - the number base (10/16)
+//             fUpper    - TRUE for upper case hex digits
+//             fNegative - TRUE to prefix a minus sign
+//             cchPad    - the minimum field width
+//             fZero     - TRUE to pad with zeros, FALSE for spaces
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID UartFormatNumber (
+   UI32  nValue,
+   UI8   nBase,
+   BOOL  fUpper,
+   BOOL  fNegative,
+   UI8   cchPad,
+   BOOL  fZero)
+{
+   CHAR  szDigits[10];
+   UI8   cchDigits = 0;
+   CHAR  chAlpha = fUpper ? 'A' - 10 : 'a' - 10;
+   // generate the digits in reverse order
+   // . avoid 32-bit division once the value fits in 16 bits,
+   //   and avoid division altogether for hex
+   do
+   {
+      UI8 nDigit;
+      if (nBase == 16)
+      {
+         nDigit = nValue & 0x0F;
+         nValue >>= 4;
+      }
+      else if (nValue > UINT16_MAX)
+      {
+         nDigit = nValue % 10;
+         nValue /= 10;
+      }
+      else
+      {
+         nDigit = (UI16)nValue % 10;
+         nValue = (UI16)nValue / 10;
+      }
+      szDigits[cchDigits++] = nDigit < 10 ? '0' + nDigit : chAlpha + nDigit;
+   } while (nValue != 0);
+   // pad and send the number
+   if (fNegative)
+   {
+      if (fZero)
+         UartSendChar('-');
+      cchPad = (cchPad > 0) ? cchPad - 1 : 0;
+   }
+   for ( ; cchPad > cchDigits; cchPad--)
+      UartSendChar(fZero ? '0' : ' ');
+   if (fNegative && !fZero)
+      UartSendChar('-');
+   while (cchDigits > 0)
+      UartSendChar(szDigits[--cchDigits]);
+}
+#endif // UART_PRINTF_MINI
+//-----------< FUNCTION: UartSendFrame >-------------------------------------
+// Purpose:    sends a COBS-framed packet over UART
+// Parameters: pvData - the packet payload
+//             cbData - the number of payload bytes
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID UartSendFrame (PCVOID pvData, UI8 cbData)
+{
+   PCBYTE pbData = (PCBYTE)pvData;
+   // compute the payload CRC, which is encoded along with the payload
+   UI16 nCrc = 0xFFFF;
+   for (UI8 i = 0; i < cbData; i++)
+      nCrc = _crc_ccitt_update(nCrc, pbData[i]);
+   BYTE pbCrc[2] = { (BYTE)nCrc, (BYTE)(nCrc >> 8) };
+   // encode the COBS blocks directly into the send ring
+   // . each block is prefixed with its length + 1 and ends at the
+   //   next zero byte, the end of the frame or after 254 bytes
+   UI16 cbTotal = (UI16)cbData + 2;
+   UI16 iBlock = 0;
+   for ( ; ; )
+   {
+      UI16 iEnd = iBlock;
+      while (iEnd < cbTotal && iEnd - iBlock < 254)
+      {
+         BYTE b = (iEnd < cbData) ? pbData[iEnd] : pbCrc[iEnd - cbData];
+         if (b == 0)
+            break;
+         iEnd++;
+      }
+      UartSendByte((BYTE)(iEnd - iBlock + 1));
+      if (iBlock < cbData)
+         UartSend(pbData + iBlock, (UI8)(Min(iEnd, cbData) - iBlock));
+      for (UI16 i = Max(iBlock, cbData); i < iEnd; i++)
+         UartSendByte(pbCrc[i - cbData]);
+      if (iEnd == cbTotal)
+         break;
+      // skip the zero byte terminating the block
+      // . a full-length block has no terminating zero
+      iBlock = (iEnd - iBlock < 254) ? iEnd + 1 : iEnd;
+   }
+   UartSendByte(UART_FRAME_DELIM);
 }
 //-----------< FUNCTION: UartRecvReady >-------------------------------------
 // Purpose:    retrieves the number of bytes available to receive
@@ -163,7 +684,7 @@ VOID UartSendLineV (PCSTR psz, va_list args)
 //---------------------------------------------------------------------------
 UI8 UartRecvReady ()
 {
-   return FifoCount(g_pRecvFifo);
+   return UartPortRecvReady(g_hUsart0);
 }
 //-----------< FUNCTION: UartRecv >------------------------------------------
 // Purpose:    receives a message on the UART interface
@@ -173,10 +694,51 @@ UI8 UartRecvReady ()
 //---------------------------------------------------------------------------
 UI8 UartRecv (PVOID pvData, UI8 cbData)
 {
-   UI8 cbRecv = 0;
-   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-      cbRecv = FifoReadBlock(g_pRecvFifo, pvData, cbData);
-   return cbRecv;
+   return UartPortRecv(g_hUsart0, pvData, cbData);
+}
+//-----------< FUNCTION: UartRecvPeek >--------------------------------------
+// Purpose:    retrieves received bytes in place, without copying them
+//             out of the receive ring
+// Parameters: pcbData - return the number of contiguous bytes via here
+// Returns:    a pointer to the oldest received byte
+//             the span may be shorter than UartRecvReady() when the ring
+//             wraps; commit it and peek again to retrieve the rest
+//---------------------------------------------------------------------------
+PCBYTE UartRecvPeek (UI8* pcbData)
+{
+   return RingPeekSpan(g_hUsart0->pRecvRing, pcbData);
+}
+//-----------< FUNCTION: UartRecvCommit >------------------------------------
+// Purpose:    releases bytes retrieved by UartRecvPeek
+// Parameters: cbData - the number of bytes consumed from the span
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID UartRecvCommit (UI8 cbData)
+{
+   RingCommitRead(g_hUsart0->pRecvRing, cbData);
+}
+//-----------< FUNCTION: UartGetStats >--------------------------------------
+// Purpose:    retrieves the send/receive queue statistics
+// Parameters: pSend - return the send ring statistics via here (optional)
+//             pRecv - return the receive ring statistics via here (optional)
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID UartGetStats (PFIFO_STATS pSend, PFIFO_STATS pRecv)
+{
+   if (pSend != NULL)
+      RingGetStats(g_hUsart0->pSendRing, pSend);
+   if (pRecv != NULL)
+      RingGetStats(g_hUsart0->pRecvRing, pRecv);
+}
+//-----------< FUNCTION: UartResetStats >------------------------------------
+// Purpose:    resets the send/receive queue statistics
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID UartResetStats ()
+{
+   RingResetStats(g_hUsart0->pSendRing);
+   RingResetStats(g_hUsart0->pRecvRing);
 }
 //-----------< INTERRUPT: USART_UDRE_vect >----------------------------------
 // Purpose:    responds to UART data register empty complete events
@@ -185,15 +747,41 @@ UI8 UartRecv (PVOID pvData, UI8 cbData)
 //---------------------------------------------------------------------------
 ISR(USART_UDRE_vect)
 {
-   if (FifoIsEmpty(g_pSendFifo))
-      RegSetLo(UCSR0B, UDRIE0);
+   // send queued bytes first, followed by any asynchronous send buffer
+   BYTE bSend;
+   BOOL fSent = FALSE;
+   if (!RingIsEmpty(g_hUsart0->pSendRing))
+      bSend = RingRead(g_hUsart0->pSendRing);
+   else if (g_cbPending != 0)
+   {
+      bSend = *g_pbPending++;
+      fSent = (--g_cbPending == 0);
+   }
    else
    {
-      BYTE bSend = FifoRead(g_pSendFifo);;
-      UDR0 = bSend;
-      if (g_pfnOnSend != NULL)
-         g_pfnOnSend(bSend);
+      RegSetLo(UCSR0B, UDRIE0);
+      return;
    }
+   UDR0 = bSend;
+   if (g_hUsart0->pfnOnSend != NULL)
+      g_hUsart0->pfnOnSend(bSend);
+   // complete the asynchronous send after its last byte
+   // . the callback may start another asynchronous send
+   if (fSent && g_pfnOnSent != NULL)
+      g_pfnOnSent(g_pvPending);
+}
+//-----------< INTERRUPT: USART_TX_vect >------------------------------------
+// Purpose:    responds to UART transmit complete events
+//             . fires once the last queued byte has been shifted out, so
+//               half-duplex/RS-485 drivers can release the line on the
+//               exact byte boundary
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+ISR(USART_TX_vect)
+{
+   if (g_pfnOnSendIdle != NULL)
+      g_pfnOnSendIdle();
 }
 //-----------< INTERRUPT: USART_RX_vect >------------------------------------
 // Purpose:    responds to UART receive complete events
@@ -203,7 +791,89 @@ ISR(USART_UDRE_vect)
 ISR(USART_RX_vect)
 {
    BYTE bRecv = UDR0;
-   FifoWrite(g_pRecvFifo, bRecv);
-   if (g_pfnOnRecv != NULL)
-      g_pfnOnRecv(bRecv);
+#if UART_FRAME
+   UartFrameRecv(bRecv);
+#elif UART_RECV_IDLE
+   // queue the byte and restart the idle timeout
+   RingWrite(g_hUsart0->pRecvRing, bRecv);
+   UART_IDLE_TCNT = 0;
+   UART_IDLE_TIFR = BitMask(UART_IDLE_OCFA);
+   RegSetHi(UART_IDLE_TIMSK, UART_IDLE_OCIEA);
+#else
+   RingWrite(g_hUsart0->pRecvRing, bRecv);
+   if (g_hUsart0->pfnOnRecv != NULL)
+      g_hUsart0->pfnOnRecv(bRecv);
+#endif
+}
+#if UART_RECV_IDLE
+//-----------< INTERRUPT: UART_IDLE_vect >-----------------------------------
+// Purpose:    responds to receive idle timeouts
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+ISR(UART_IDLE_vect)
+{
+   RegSetLo(UART_IDLE_TIMSK, UART_IDLE_OCIEA);
+   // deliver the burst, then rewind the receive ring
+   // . both ends of the ring are owned by ISRs in burst mode, so the
+   //   ring can be rewound, and every burst starts at the beginning
+   //   of the buffer in a single contiguous span
+   UI8    cbBurst = 0;
+   PCBYTE pbBurst = RingPeekSpan(g_hUsart0->pRecvRing, &cbBurst);
+   if (cbBurst > 0 && g_pfnOnRecvBurst != NULL)
+      g_pfnOnRecvBurst(pbBurst, cbBurst);
+   g_hUsart0->pRecvRing->nHead = g_hUsart0->pRecvRing->nTail = 0;
+}
+#endif // UART_RECV_IDLE
+#if UART_FRAME
+//-----------< FUNCTION: UartFrameRecv >-------------------------------------
+// Purpose:    decodes a received byte into the current frame
+// Parameters: bRecv - the received byte
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID UartFrameRecv (BYTE bRecv)
+{
+   if (bRecv == UART_FRAME_DELIM)
+   {
+      // end of frame, deliver the payload if it is complete and intact
+      // . the CRC over the payload and its little-endian CRC is zero
+      // . partial frames (received after a reset) fail the CRC check
+      if (!g_fFrameError && g_cbBlock == 0 && g_cbFrame >= 2 && g_nFrameCrc == 0)
+         if (g_pfnOnFrame != NULL)
+            g_pfnOnFrame(g_pbFrame, g_cbFrame - 2);
+      g_cbFrame = 0;
+      g_cbBlock = 0;
+      g_fBlockZero = FALSE;
+      g_fFrameError = FALSE;
+      g_nFrameCrc = 0xFFFF;
+   }
+   else if (g_cbBlock == 0)
+   {
+      // start of a COBS block, append the previous block's zero byte
+      if (g_fBlockZero)
+         UartFrameAppend(0);
+      g_cbBlock = bRecv - 1;
+      g_fBlockZero = (bRecv != 0xFF);
+   }
+   else
+   {
+      UartFrameAppend(bRecv);
+      g_cbBlock--;
+   }
+}
+//-----------< FUNCTION: UartFrameAppend >-----------------------------------
+// Purpose:    appends a decoded byte to the current frame
+// Parameters: b - the decoded byte
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID UartFrameAppend (BYTE b)
+{
+   if (g_cbFrame < sizeof(g_pbFrame))
+   {
+      g_pbFrame[g_cbFrame++] = b;
+      g_nFrameCrc = _crc_ccitt_update(g_nFrameCrc, b);
+   }
+   else
+      g_fFrameError = TRUE;
 }
+#endif // UART_FRAME
@@ -23,19 +23,47 @@
 //-------------------[       Pre Include Defines       ]-------------------//
 //-------------------[      Library Include Files      ]-------------------//
 #include <stdio.h>
+#include <avr/pgmspace.h>
 //-------------------[      Project Include Files      ]-------------------//
 #ifndef __AVRDEFS_H
 #include "avrdefs.h"
 #endif
+#ifndef __FIFO_H
+#include "fifo.h"
+#endif
 //-------------------[       Module Definitions        ]-------------------//
 //===========================================================================
 // UART CONFIGURATION
 // . UART_SEND:               enable UART send
 // . UART_RECV:               enable UART receive
-// . UART_BAUD:               sets the base UART baud rate
-// . UART_BAUD_2X:            sets the UART 2x baud rate multiplier
+// . UART_BAUD:               sets the base UART baud rate (up to F_CPU/8)
+// . UART_BAUD_2X:            forces the UART 2x baud rate multiplier on
+//                            or off, by default the mode with the lowest
+//                            baud rate error is selected
+// . UART_BAUD_TOLERANCE      sets the maximum baud rate error, in tenths
+//                            of a percent
 // . UART_SEND_BUFFER_SIZE    sets the UART send buffer size, in bytes
+//                            (power of 2, up to 128)
 // . UART_RECV_BUFFER_SIZE    sets the UART receive buffer size, in bytes
+//                            (power of 2, up to 128)
+// . UART_SEND_POLICY         sets the send buffer overflow policy
+//                            (REJECT blocks the sender, DROP discards)
+// . UART_RECV_POLICY         sets the receive buffer overflow policy
+//                            (DROP discards new bytes when full)
+// . UART_PRINTF_MINI         use a compact integer-only formatter in
+//                            place of the avr-libc vfprintf
+// . UART_FRAME               enable COBS/CRC-16 framed packet receive,
+//                            replacing the receive buffer and per-byte
+//                            receive callback
+// . UART_FRAME_SIZE          sets the maximum received frame payload
+//                            length, in bytes
+// . UART_RECV_IDLE           enable burst receive, delivering received
+//                            bytes once the line has been idle for this
+//                            many character times (0 = per-byte)
+// . UART_RECV_IDLE_TIMER     sets the 8-bit timer (0 or 2) used for the
+//                            idle timeout, reserved by the UART module
+//                            (timer 2 conflicts with the i2cmast timeout,
+//                            I2C_TIMEOUT_TICKS, so use 0 with i2cmast)
 //===========================================================================
 // configuration properties
 #ifndef UART_SEND
@@ -46,45 +74,198 @@
 #endif
 #ifndef UART_BAUD
 #  define UART_BAUD                    (57600)
-#  define UART_BAUD_2X                 (0)
+#endif
+#ifndef UART_BAUD_TOLERANCE
+#  define UART_BAUD_TOLERANCE          (25)
 #endif
 #if !UART_SEND
 #  define UART_SEND_BUFFER_SIZE        (1)
 #elif !defined(UART_SEND_BUFFER_SIZE)
 #  define UART_SEND_BUFFER_SIZE        (16)
 #endif
-#if !UART_RECV
+#ifndef UART_FRAME
+#  define UART_FRAME                   (0)
+#endif
+#if !UART_FRAME
+#  define UART_FRAME_SIZE              (0)
+#elif !defined(UART_FRAME_SIZE)
+#  define UART_FRAME_SIZE              (32)
+#endif
+#if UART_FRAME_SIZE > 253
+#  error UART_FRAME_SIZE must be less than 254
+#endif
+#ifndef UART_RECV_IDLE
+#  define UART_RECV_IDLE               (0)
+#endif
+#ifndef UART_RECV_IDLE_TIMER
+#  define UART_RECV_IDLE_TIMER         (2)
+#endif
+#if UART_RECV_IDLE && UART_RECV_IDLE_TIMER == 2 && \
+    defined(I2C_TIMEOUT_TICKS) && I2C_TIMEOUT_TICKS
+#  error I2C_TIMEOUT_TICKS and UART_RECV_IDLE both use timer 2, set UART_RECV_IDLE_TIMER=0
+#endif
+#if UART_RECV_IDLE && UART_FRAME
+#  error UART_RECV_IDLE and UART_FRAME are mutually exclusive
+#endif
+#if !UART_RECV || UART_FRAME
 #  define UART_RECV_BUFFER_SIZE        (1)
 #elif !defined(UART_RECV_BUFFER_SIZE)
 #  define UART_RECV_BUFFER_SIZE        (16)
 #endif
-// UART callback
+#ifndef UART_SEND_POLICY
+#  define UART_SEND_POLICY             FIFO_POLICY_REJECT
+#endif
+#ifndef UART_RECV_POLICY
+#  define UART_RECV_POLICY             FIFO_POLICY_DROP
+#endif
+#ifndef UART_PRINTF_MINI
+#  define UART_PRINTF_MINI             (0)
+#endif
+//===========================================================================
+// UART BAUD RATE
+// . the divisor is rounded to the nearest value for both the normal (16x)
+//   and double speed (8x) modes, and the mode with the lowest error wins
+// . ties go to normal mode, which samples each bit more times
+// . constants stay within 32 bits, for -mint8 builds
+// . UART_BAUD_ERROR is the resulting error, in tenths of a percent
+//===========================================================================
+#if UART_BAUD > F_CPU / 8
+#  error UART_BAUD exceeds F_CPU/8
+#endif
+#define UART_UBRR_1X                   ((F_CPU + 8ULL * UART_BAUD) / (16ULL * UART_BAUD) - 1)
+#define UART_UBRR_2X                   ((F_CPU + 4ULL * UART_BAUD) / (8ULL * UART_BAUD) - 1)
+#define UartBaudClock(ubrr, div)       (((ubrr) + 1ULL) * (div) * UART_BAUD)
+#define UartBaudError(ubrr, div)       (                                   \
+   F_CPU > UartBaudClock(ubrr, div) ?                                      \
+      (F_CPU - UartBaudClock(ubrr, div)) / (UartBaudClock(ubrr, div) / 1000) : \
+      (UartBaudClock(ubrr, div) - F_CPU) / (UartBaudClock(ubrr, div) / 1000))
+#if defined(UART_BAUD_2X)
+#elif UART_UBRR_2X > 4095
+#  define UART_BAUD_2X                 (0)
+#elif UartBaudError(UART_UBRR_2X, 8) < UartBaudError(UART_UBRR_1X, 16)
+#  define UART_BAUD_2X                 (1)
+#else
+#  define UART_BAUD_2X                 (0)
+#endif
+#if UART_BAUD_2X
+#  define UART_UBRR                    UART_UBRR_2X
+#  define UART_BAUD_ERROR              UartBaudError(UART_UBRR_2X, 8)
+#else
+#  define UART_UBRR                    UART_UBRR_1X
+#  define UART_BAUD_ERROR              UartBaudError(UART_UBRR_1X, 16)
+#endif
+#if UART_UBRR > 4095
+#  error UART_BAUD is too low for the UART baud rate divisor
+#endif
+#if UART_BAUD_ERROR > UART_BAUD_TOLERANCE
+#  error UART baud rate error exceeds UART_BAUD_TOLERANCE
+#endif
+// UART callbacks
 typedef VOID (*UART_CALLBACK) (BYTE bData);
+typedef VOID (*UART_FRAME_CALLBACK) (PCBYTE pbFrame, UI8 cbFrame);
+typedef VOID (*UART_BURST_CALLBACK) (PCBYTE pbData, UI8 cbData);
+typedef VOID (*UART_SEND_CALLBACK) (PCVOID pvData);
+typedef VOID (*UART_EVENT_CALLBACK) ();
 // configuration structure
 typedef struct tagUartConfig
 {
    UART_CALLBACK  pfnOnSend;           // send complete callback
    UART_CALLBACK  pfnOnRecv;           // receive complete callback
+   UART_FRAME_CALLBACK pfnOnFrame;     // frame receive callback (ISR)
+   UART_BURST_CALLBACK pfnOnRecvBurst; // burst receive callback
+   UART_EVENT_CALLBACK pfnOnSendIdle;  // transmitter idle (TXC) callback
 } UART_CONFIG, *PUART_CONFIG;
 //===========================================================================
+// UART PORTS
+// . a port couples a send/receive ring pair with the back end (USART0,
+//   software UART) that drains the send ring and fills the receive ring
+// . pfnStartSend is called after data is queued, to restart the back end
+//   transmitter if it has gone idle
+// . the port API works on any port; framing, asynchronous send, burst
+//   receive and the stdio stream are specific to USART0
+//===========================================================================
+typedef struct tagUart
+{
+   PRING          pSendRing;           // send queue, drained by the back end
+   PRING          pRecvRing;           // receive queue, filled by the back end
+   UART_CALLBACK  pfnOnSend;           // send complete callback
+   UART_CALLBACK  pfnOnRecv;           // receive complete callback
+   UART_EVENT_CALLBACK pfnStartSend;   // back end transmitter start
+} UART, *UART_HANDLE;
+// port declaration
+#define DECLARE_UART(name, cbSend, cbRecv, pfnStart)                       \
+   DECLARE_UART_POLICY(                                                    \
+      name,                                                                \
+      cbSend, FIFO_POLICY_REJECT,                                          \
+      cbRecv, FIFO_POLICY_DROP,                                            \
+      pfnStart)
+#define DECLARE_UART_POLICY(name, cbSend, send, cbRecv, recv, pfnStart)    \
+   DECLARE_RING_POLICY(name##_SendRing, cbSend, send);                     \
+   DECLARE_RING_POLICY(name##_RecvRing, cbRecv, recv);                     \
+   static UART __Uart_##name =                                             \
+      { .pSendRing = &__RingBuffer_##name##_SendRing.Ring,                 \
+        .pRecvRing = &__RingBuffer_##name##_RecvRing.Ring,                 \
+        .pfnStartSend = pfnStart };                                        \
+   static UART_HANDLE name __attribute__((unused)) = &__Uart_##name
+//===========================================================================
+// UART FRAMING
+// . frames are COBS-encoded and terminated with a zero byte
+// . the payload is followed by a CRC-16 (CCITT reflected, 0xFFFF initial
+//   value, little-endian), computed before encoding
+// . the frame callback is invoked from the receive ISR with the validated
+//   payload, which is only valid until the callback returns
+//===========================================================================
+#define UART_FRAME_DELIM               0x00     // frame delimiter
+#define UART_FRAME_OVERHEAD(cb)        (((cb) + 2) / 254 + 4) // max encoding
+//===========================================================================
+// UART BURST RECEIVE
+// . each received byte is queued and restarts the idle timer, instead of
+//   calling pfnOnRecv
+// . when the timer expires, pfnOnRecvBurst is called from the timer ISR
+//   with the contiguous span of received bytes in the receive buffer,
+//   which is released when the callback returns
+// . bursts longer than UART_RECV_BUFFER_SIZE are truncated according to
+//   UART_RECV_POLICY
+// . the callback runs with interrupts disabled, so it should reply with
+//   UartTrySend/UartBeginSend rather than block in UartSend
+//===========================================================================
+//===========================================================================
 // UART INTERFACE
 //===========================================================================
 // UART API
 VOID     UartInit       (PUART_CONFIG pConfig);
 UI8      UartSendReady  ();
 VOID     UartSend       (PCVOID pvData, UI8 cbData);
+UI8      UartTrySend    (PCVOID pvData, UI8 cbData);
+BOOL     UartBeginSend  (PCVOID pvData, UI8 cbData, UART_SEND_CALLBACK pfnOnSent);
+BOOL     UartIsSendBusy ();
 VOID     UartSendDelim  (PCVOID pvData, UI8 cbData, BYTE bDelim);
 VOID     UartSendStr    (PCSTR psz, ...);
 VOID     UartSendStrV   (PCSTR psz, va_list args);
 VOID     UartSendLine   (PCSTR psz, ...);
 VOID     UartSendLineV  (PCSTR psz, va_list args);
+VOID     UartSendStr_P  (PCSTR psz, ...);
+VOID     UartSendStrV_P (PCSTR psz, va_list args);
+VOID     UartSendLine_P (PCSTR psz, ...);
+VOID     UartSendLineV_P(PCSTR psz, va_list args);
+FILE*    UartGetStream  ();
+VOID     UartSendFrame  (PCVOID pvData, UI8 cbData);
 UI8      UartRecvReady  ();
 UI8      UartRecv       (PVOID pvData, UI8 cbData);
+PCBYTE   UartRecvPeek   (UI8* pcbData);
+VOID     UartRecvCommit (UI8 cbData);
+VOID     UartGetStats   (PFIFO_STATS pSend, PFIFO_STATS pRecv);
+VOID     UartResetStats ();
+UART_HANDLE UartGetHandle ();
+// UART port API
+UI8      UartPortSendReady (UART_HANDLE hUart);
+VOID     UartPortSend      (UART_HANDLE hUart, PCVOID pvData, UI8 cbData);
+UI8      UartPortTrySend   (UART_HANDLE hUart, PCVOID pvData, UI8 cbData);
+UI8      UartPortRecvReady (UART_HANDLE hUart);
+UI8      UartPortRecv      (UART_HANDLE hUart, PVOID pvData, UI8 cbData);
 // UART helpers
 inline VOID UartSendByte (BYTE b)
    { UartSend(&b, 1); }
 inline VOID UartSendChar (CHAR ch)
    { UartSend(&ch, 1); }
-// UART tracing
-#define UartTrace UartSendStr
 #endif // __UART_H
@@ -0,0 +1,379 @@
+//===========================================================================
+// Module:  uspimast.c
+// Purpose: AVR USART master SPI mode (MSPIM) driver
+//
+// Copyright © 2013
+// Brent M. Spell. All rights reserved.
+//
+// This library is free software; you can redistribute it and/or modify it 
+// under the terms of the GNU Lesser General Public License as published 
+// by the Free Software Foundation; either version 3 of the License, or 
+// (at your option) any later version. This library is distributed in the 
+// hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+// See the GNU Lesser General Public License for more details. You should 
+// have received a copy of the GNU Lesser General Public License along with 
+// this library; if not, write to 
+//    Free Software Foundation, Inc. 
+//    51 Franklin Street, Fifth Floor 
+//    Boston, MA 02110-1301 USA
+//===========================================================================
+//-------------------[       Pre Include Defines       ]-------------------//
+//-------------------[      Library Include Files      ]-------------------//
+//-------------------[      Project Include Files      ]-------------------//
+#include "uspimast.h"
+//-------------------[       Module Definitions        ]-------------------//
+#if USPI_FREQUENCY > F_CPU / 2
+#  error USPI_FREQUENCY exceeds the maximum XCK rate (F_CPU/2)
+#elif USPI_UBRR > 4095
+#  error USPI_FREQUENCY is below the minimum XCK rate (F_CPU/8192)
+#endif
+// the number of bytes that may be in flight (sent but not yet received),
+// which keeps the transmit buffer full without overrunning the receiver
+#define USPI_XFER_DEPTH       2
+// transfer cursor
+// . walks the send or receive side of a transaction one byte at a time,
+//   across its segments
+typedef struct tagUSpiCursor
+{
+   PBYTE          pbData;                 // segment buffer (or NULL)
+   BSIZE          cbData;                 // segment buffer length
+   BSIZE          cbXfer;                 // segment exchange length
+   BSIZE          nXfer;                  // segment bytes exchanged
+   PBUS_SEGMENT   pSegment;               // next segment
+   UI8            cSegments;              // segments remaining
+} USPI_CURSOR, *PUSPI_CURSOR;
+//-------------------[        Module Variables         ]-------------------//
+// transaction queue
+// . the head transaction is the one in progress on the bus
+static PBUS_TRANSACTION volatile g_pHead = NULL;   // queue head
+static PBUS_TRANSACTION volatile g_pTail = NULL;   // queue tail
+// head transfer state
+// . only accessed with interrupts disabled
+static USPI_CURSOR g_Send;                         // send cursor
+static USPI_CURSOR g_Recv;                         // receive cursor
+static BSIZE g_cbSendLeft = 0;                     // bytes left to send
+static BSIZE g_cbRecvLeft = 0;                     // bytes left to receive
+//-------------------[        Module Prototypes        ]-------------------//
+static BSIZE USpiTransLength (PBUS_TRANSACTION pTrans);
+static VOID USpiBegin (PBUS_TRANSACTION pTrans);
+static VOID USpiFill ();
+static VOID USpiDrain ();
+static VOID USpiPoll (PBUS_TRANSACTION pTrans);
+//-------------------[         Implementation          ]-------------------//
+//-----------< FUNCTION: USpiInit >------------------------------------------
+// Purpose:    USART SPI interface initialization
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID USpiInit ()
+{
+   // the baud rate must be zero while the transmitter is enabled,
+   // and is then set to the XCK frequency
+   UBRR0 = 0;
+   PinSetOutput(PIN_XCK);
+   UCSR0C = (1 << UMSEL01) | (1 << UMSEL00) |  // master SPI mode
+            (USPI_LSB  << UDORD0) |            // set bit order
+            (USPI_CPHA << UCPHA0) |            // set clock phase
+            (USPI_CPOL << UCPOL0);             // set clock polarity
+   UCSR0B = (1 << RXEN0) | (1 << TXEN0);
+   UBRR0 = USPI_UBRR;
+}
+//-----------< FUNCTION: USpiIsBusy >----------------------------------------
+// Purpose:    polls the USART SPI busy state
+// Parameters: none
+// Returns:    TRUE if there is an I/O in progress
+//             FALSE otherwise
+//---------------------------------------------------------------------------
+BOOL USpiIsBusy ()
+{
+   // busy while any transaction is queued
+   return g_pHead != NULL;
+}
+//-----------< FUNCTION: USpiWait >------------------------------------------
+// Purpose:    waits for the USART SPI bus to become available
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID USpiWait ()
+{
+   while (USpiIsBusy())
+      ;
+}
+//-----------< FUNCTION: USpiQueue >-----------------------------------------
+// Purpose:    queues a transaction on the USART SPI bus, starting it if
+//             the bus is idle
+// Parameters: pTrans - the transaction to queue, which must not already
+//                      be queued
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID USpiQueue (PBUS_TRANSACTION pTrans)
+{
+   // empty transactions complete immediately
+   if (USpiTransLength(pTrans) == 0)
+   {
+      pTrans->fBusy   = FALSE;
+      pTrans->nStatus = BUS_STATUS_OK;
+      if (pTrans->pfnOnComplete != NULL)
+         pTrans->pfnOnComplete(pTrans);
+      return;
+   }
+   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+   {
+      pTrans->pNext   = NULL;
+      pTrans->fBusy   = TRUE;
+      pTrans->nStatus = BUS_STATUS_BUSY;
+      if (g_pHead == NULL)
+      {
+         g_pHead = g_pTail = pTrans;
+         USpiBegin(pTrans);
+         RegSetHi(UCSR0B, RXCIE0);
+      }
+      else
+      {
+         g_pTail->pNext = pTrans;
+         g_pTail = pTrans;
+      }
+   }
+}
+//-----------< FUNCTION: USpiExecute >---------------------------------------
+// Purpose:    executes a transaction synchronously
+//             short transfers are faster to poll than to run from the ISR,
+//             but the bus must be idle, so wait for any queued transactions
+// Parameters: pTrans - the transaction to execute
+// Returns:    the transaction status (BUS_STATUS_*)
+//---------------------------------------------------------------------------
+UI8 USpiExecute (PBUS_TRANSACTION pTrans)
+{
+#if USPI_POLL_THRESHOLD > 0
+   if (USpiTransLength(pTrans) <= USPI_POLL_THRESHOLD)
+   {
+      for ( ; ; )
+      {
+         ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+         {
+            if (g_pHead == NULL)
+            {
+               USpiPoll(pTrans);
+               return pTrans->nStatus;
+            }
+         }
+      }
+   }
+#endif
+   USpiQueue(pTrans);
+   return BusTransWait(pTrans);
+}
+//-----------< FUNCTION: USpiSendRecv >--------------------------------------
+// Purpose:    executes a combined send/receive transaction on the bus
+// Parameters: nSsPin - slave select pin number (or PIN_INVALID for no SS)
+//             pvSend - send message buffer
+//             cbSend - number of bytes to send
+//             pvRecv - receive message buffer
+//             cbRecv - number of bytes to receive
+// Returns:    actual number of bytes received
+//---------------------------------------------------------------------------
+BSIZE USpiSendRecv (
+   UI8    nSsPin,
+   PCVOID pvSend,
+   BSIZE  cbSend,
+   PVOID  pvRecv,
+   BSIZE  cbRecv)
+{
+   BUS_TRANSACTION trans =
+   {
+      .nAddress = nSsPin,
+      .pbSend   = pvSend,
+      .cbSend   = cbSend,
+      .pbRecv   = pvRecv,
+      .cbRecv   = cbRecv
+   };
+   USpiExecute(&trans);
+   return pvRecv != NULL ? cbRecv : 0;
+}
+//-----------< FUNCTION: USpiSendRecvV >-------------------------------------
+// Purpose:    executes a segmented send/receive transaction on the bus
+//             under a single slave select
+// Parameters: nSsPin    - slave select pin number (or PIN_INVALID for no SS)
+//             pSegments - the segments to exchange, in order
+//             cSegments - the number of segments
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID USpiSendRecvV (
+   UI8          nSsPin,
+   PBUS_SEGMENT pSegments,
+   UI8          cSegments)
+{
+   BUS_TRANSACTION trans =
+   {
+      .nAddress  = nSsPin,
+      .pSegments = pSegments,
+      .cSegments = cSegments
+   };
+   USpiExecute(&trans);
+}
+//-----------< FUNCTION: USpiTransLength >-----------------------------------
+// Purpose:    calculates the number of bytes exchanged by a transaction
+// Parameters: pTrans - the transaction to measure
+// Returns:    the total exchange length, in bytes
+//---------------------------------------------------------------------------
+static BSIZE USpiTransLength (PBUS_TRANSACTION pTrans)
+{
+   if (pTrans->cSegments == 0)
+      return Max(pTrans->cbSend, pTrans->cbRecv);
+   BSIZE cbXfer = 0;
+   for (UI8 i = 0; i < pTrans->cSegments; i++)
+      cbXfer += pTrans->pSegments[i].cbData;
+   return cbXfer;
+}
+//-----------< FUNCTION: USpiCursorInit >------------------------------------
+// Purpose:    points a transfer cursor at the start of a transaction
+// Parameters: pCursor - the cursor to initialize
+//             pTrans  - the transaction
+//             fSend   - TRUE for the send side, FALSE for the receive side
+// Returns:    none
+//---------------------------------------------------------------------------
+static inline VOID USpiCursorInit (
+   PUSPI_CURSOR     pCursor,
+   PBUS_TRANSACTION pTrans,
+   BOOL             fSend)
+{
+   pCursor->pSegment  = pTrans->pSegments;
+   pCursor->cSegments = pTrans->cSegments;
+   pCursor->nXfer     = 0;
+   if (pCursor->cSegments != 0)
+      pCursor->cbXfer = 0;
+   else
+   {
+      pCursor->pbData = fSend ? (PBYTE)pTrans->pbSend : pTrans->pbRecv;
+      pCursor->cbData = fSend ? pTrans->cbSend : pTrans->cbRecv;
+      pCursor->cbXfer = Max(pTrans->cbSend, pTrans->cbRecv);
+   }
+}
+//-----------< FUNCTION: USpiCursorNext >------------------------------------
+// Purpose:    advances a transfer cursor to its next byte
+//             the transaction must have a byte left on this side
+// Parameters: pCursor - the cursor to advance
+//             fSend   - TRUE for the send side, FALSE for the receive side
+// Returns:    a pointer to the byte's buffer slot, or NULL if the byte
+//             is sent as zero/discarded
+//---------------------------------------------------------------------------
+static inline PBYTE USpiCursorNext (PUSPI_CURSOR pCursor, BOOL fSend)
+{
+   // move to the next non-empty segment
+   while (pCursor->nXfer >= pCursor->cbXfer)
+   {
+      PBUS_SEGMENT pSegment = pCursor->pSegment++;
+      pCursor->cSegments--;
+      pCursor->pbData = fSend ? (PBYTE)pSegment->pbSend : pSegment->pbRecv;
+      pCursor->cbData = pCursor->cbXfer = pSegment->cbData;
+      pCursor->nXfer  = 0;
+   }
+   BSIZE nXfer = pCursor->nXfer++;
+   return (nXfer < pCursor->cbData && pCursor->pbData != NULL) ?
+      &pCursor->pbData[nXfer] :
+      NULL;
+}
+//-----------< FUNCTION: USpiBegin >-----------------------------------------
+// Purpose:    selects the slave and starts a transaction on the bus
+// Parameters: pTrans - the transaction to start, which must not be empty
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID USpiBegin (PBUS_TRANSACTION pTrans)
+{
+   USpiCursorInit(&g_Send, pTrans, TRUE);
+   USpiCursorInit(&g_Recv, pTrans, FALSE);
+   g_cbSendLeft = g_cbRecvLeft = USpiTransLength(pTrans);
+   if (pTrans->nAddress != PIN_INVALID)
+      PinSetLo(pTrans->nAddress);
+   USpiFill();
+}
+//-----------< FUNCTION: USpiFill >------------------------------------------
+// Purpose:    writes bytes to the transmit buffer while it has room
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID USpiFill ()
+{
+   while (g_cbSendLeft != 0 &&
+          g_cbRecvLeft - g_cbSendLeft < USPI_XFER_DEPTH &&
+          RegGet(UCSR0A, UDRE0))
+   {
+      PBYTE pbSend = USpiCursorNext(&g_Send, TRUE);
+      UDR0 = pbSend != NULL ? *pbSend : 0;
+      g_cbSendLeft--;
+   }
+}
+//-----------< FUNCTION: USpiDrain >-----------------------------------------
+// Purpose:    reads all bytes available in the receive buffer
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID USpiDrain ()
+{
+   while (g_cbRecvLeft != 0 && RegGet(UCSR0A, RXC0))
+   {
+      BYTE bRecv = UDR0;
+      PBYTE pbRecv = USpiCursorNext(&g_Recv, FALSE);
+      if (pbRecv != NULL)
+         *pbRecv = bRecv;
+      g_cbRecvLeft--;
+   }
+}
+//-----------< FUNCTION: USpiPoll >------------------------------------------
+// Purpose:    executes a transaction by polling the USART status flags,
+//             with the bus idle and interrupts disabled
+// Parameters: pTrans - the transaction to execute
+// Returns:    none
+//---------------------------------------------------------------------------
+static VOID USpiPoll (PBUS_TRANSACTION pTrans)
+{
+   USpiBegin(pTrans);
+   while (g_cbRecvLeft != 0)
+   {
+      USpiDrain();
+      USpiFill();
+   }
+   if (pTrans->nAddress != PIN_INVALID)
+      PinSetHi(pTrans->nAddress);
+   // complete the transaction as the ISR would
+   pTrans->fBusy   = FALSE;
+   pTrans->nStatus = BUS_STATUS_OK;
+   if (pTrans->pfnOnComplete != NULL)
+      pTrans->pfnOnComplete(pTrans);
+}
+//-----------< INTERRUPT: USART_RX_vect >------------------------------------
+// Purpose:    responds to USART SPI receive complete events
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+ISR(USART_RX_vect)
+{
+   // transfer the received bytes to the receive buffer
+   // refill the transmit buffer while more data remains
+   USpiDrain();
+   if (g_cbRecvLeft != 0)
+   {
+      USpiFill();
+      return;
+   }
+   // end the transaction on the slave
+   PBUS_TRANSACTION pTrans = g_pHead;
+   if (pTrans->nAddress != PIN_INVALID)
+      PinSetHi(pTrans->nAddress);
+   // start the next transaction back to back, or disable this
+   // interrupt to free up the bus
+   if ((g_pHead = pTrans->pNext) != NULL)
+      USpiBegin(g_pHead);
+   else
+   {
+      g_pTail = NULL;
+      RegSetLo(UCSR0B, RXCIE0);
+   }
+   // release the transaction and dispatch the callback,
+   // which may queue it again
+   pTrans->nStatus = BUS_STATUS_OK;
+   pTrans->fBusy   = FALSE;
+   if (pTrans->pfnOnComplete != NULL)
+      pTrans->pfnOnComplete(pTrans);
+}
@@ -0,0 +1,97 @@
+//===========================================================================
+// Module:  uspimast.h
+// Purpose: AVR USART master SPI mode (MSPIM) driver
+//
+// Copyright © 2013
+// Brent M. Spell. All rights reserved.
+//
+// This library is free software; you can redistribute it and/or modify it 
+// under the terms of the GNU Lesser General Public License as published 
+// by the Free Software Foundation; either version 3 of the License, or 
+// (at your option) any later version. This library is distributed in the 
+// hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+// See the GNU Lesser General Public License for more details. You should 
+// have received a copy of the GNU Lesser General Public License along with 
+// this library; if not, write to 
+//    Free Software Foundation, Inc. 
+//    51 Franklin Street, Fifth Floor 
+//    Boston, MA 02110-1301 USA
+//===========================================================================
+#ifndef __USPIMAST_H
+#define __USPIMAST_H
+//-------------------[       Pre Include Defines       ]-------------------//
+//-------------------[      Library Include Files      ]-------------------//
+//-------------------[      Project Include Files      ]-------------------//
+#ifndef __AVRDEFS_H
+#include "avrdefs.h"
+#endif
+#ifndef __SPIMAST_H
+#include "spimast.h"
+#endif
+//-------------------[       Module Definitions        ]-------------------//
+//===========================================================================
+// USART SPI CONFIGURATION
+// . this driver runs USART0 as a second SPI master bus, with SCK on XCK,
+//   MOSI on TXD and MISO on RXD, so it cannot be used with the uart module
+// . the USART transmit buffer keeps the next byte ready while the current
+//   one shifts out, so bytes are streamed back to back
+// . transactions and segments are the same as for the spimast bus, but
+//   the SPI device (pvDevice) is ignored, since the bus settings are fixed
+// . USPI_FREQUENCY           frequency of the XCK clock, in Hz
+//                            (the fastest rate that does not exceed this
+//                            is used, see USPI_ACTUAL_FREQUENCY)
+// . USPI_LSB                 set to TRUE to enable least-signifcant-bit first
+// . USPI_CPOL                SPI mode for clock polarity
+// . USPI_CPHA                SPI mode for clock phase
+// . USPI_POLL_THRESHOLD      longest USpiSendRecv/USpiSendRecvV transfer
+//                            that is polled with interrupts disabled,
+//                            instead of queued to the ISR, in bytes
+//                            (0 to disable)
+//===========================================================================
+#ifndef USPI_FREQUENCY
+#  define USPI_FREQUENCY      8000000
+#endif
+#ifndef USPI_LSB
+#  define USPI_LSB            FALSE
+#endif      
+#ifndef USPI_CPOL     
+#  define USPI_CPOL           0
+#endif      
+#ifndef USPI_CPHA     
+#  define USPI_CPHA           0
+#endif
+#ifndef USPI_POLL_THRESHOLD
+#  define USPI_POLL_THRESHOLD 4
+#endif
+// XCK = F_CPU / (2 * (UBRR0 + 1)), with UBRR0 rounded up so that
+// the actual frequency does not exceed USPI_FREQUENCY
+#define USPI_UBRR                                                          \
+   (((F_CPU) + 2 * (USPI_FREQUENCY) - 1) / (2 * (USPI_FREQUENCY)) - 1)
+#define USPI_ACTUAL_FREQUENCY                                              \
+   ((F_CPU) / (2 * (USPI_UBRR + 1)))
+//===========================================================================
+// USART SPI INTERFACE
+//===========================================================================
+VOID     USpiInit          ();
+BOOL     USpiIsBusy        ();
+VOID     USpiWait          ();
+VOID     USpiQueue         (PBUS_TRANSACTION pTrans);
+UI8      USpiExecute       (PBUS_TRANSACTION pTrans);
+BSIZE    USpiSendRecv      (UI8          nSsPin, 
+                            PCVOID       pvSend, 
+                            BSIZE        cbSend,
+                            PVOID        pvRecv, 
+                            BSIZE        cbRecv);
+VOID     USpiSendRecvV     (UI8          nSsPin,
+                            PBUS_SEGMENT pSegments,
+                            UI8          cSegments);
+// USART SPI one-way helpers
+inline VOID USpiSend (UI8 nSsPin, PCVOID pvSend, BSIZE cbSend)
+   { USpiSendRecv(nSsPin, pvSend, cbSend, NULL, 0); }
+inline BSIZE USpiRecv (UI8 nSsPin, PVOID pvRecv, BSIZE cbRecv)
+   { return USpiSendRecv(nSsPin, NULL, 0, pvRecv, cbRecv); }
+// USART SPI bus interface initializer
+#define USPI_BUS                                                           \
+   { .pfnQueue = USpiQueue, .pfnExecute = USpiExecute }
+#endif // __USPIMAST_H
@@ -24,6 +24,7 @@
 //-------------------[      Project Include Files      ]-------------------//
 #include "lab.h"
 #include "uart.h"
+#include "trace.h"
 #include "i2cmast.h"
 #include "spimast.h"
 #include "mpu6050.h"
@@ -36,6 +37,7 @@
 //-------------------[        Module Prototypes        ]-------------------//
 static VOID LabInit  ();
 static VOID LabRun   ();
+static VOID LabSpiBenchmark ();
 //-------------------[         Implementation          ]-------------------//
 //-----------< FUNCTION: main >----------------------------------------------
 // Purpose:    program entry point
@@ -83,6 +85,9 @@ VOID LabInit ()
 
    SevenSegSet16(1234);
 
+   SpiInit();
+   LabSpiBenchmark();
+
    /*// 1kHz clock 0
    TCCR0A = BitMask(COM0A0) | BitMask(WGM01);
    TCCR0B = AvrClk0Scale(64);
@@ -103,6 +108,50 @@ VOID LabInit ()
 //---------------------------------------------------------------------------
 VOID LabRun ()
 {
+   TraceFlush();
+}
+//-----------< FUNCTION: LabSpiBenchmark >-----------------------------------
+// Purpose:    compares the CPU cycles taken by polled and interrupt-driven
+//             SPI transfers of register access sizes, and reports them
+//             over UART
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID LabSpiBenchmark ()
+{
+   BYTE pbData[3] = { 0xFF, 0xFF, 0xFF };
+   BUS_TRANSACTION trans = { .nAddress = PIN_INVALID, .pbSend = pbData };
+   // count CPU cycles with timer 1, unscaled
+   TCCR1A = 0;
+   TCCR1B = AvrClk1Scale(1);
+   for (UI8 cbData = 1; cbData <= sizeof(pbData); cbData++)
+   {
+      UI16 nPolled = 0;
+      UI16 nQueued = 0;
+      for (UI8 i = 0; i < 16; i++)
+      {
+         // polled, for transfers up to SPI_POLL_THRESHOLD
+         UI16 nStart = TCNT1;
+         SpiSendRecv(PIN_INVALID, pbData, cbData, pbData, cbData);
+         nPolled += TCNT1 - nStart;
+         // interrupt-driven
+         trans.cbSend = trans.cbRecv = cbData;
+         trans.pbRecv = pbData;
+         nStart = TCNT1;
+         SpiQueue(&trans);
+         BusTransWait(&trans);
+         nQueued += TCNT1 - nStart;
+      }
+      UartSendLine(
+         "spi %u bytes: polled %u, queued %u cycles",
+         (UI16)cbData,
+         nPolled / 16,
+         nQueued / 16
+      );
+   }
+   // leave timer 1 free-running for the trace timestamps (TRACE_CLOCK),
+   // at 4us per tick
+   TCCR1B = AvrClk1Scale(64);
 }
 //-----------< INTERRUPT: TIMER2_COMPA_vect >--------------------------------
 // Purpose:    handles timer 2 ticks
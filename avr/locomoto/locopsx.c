@@ -39,7 +39,9 @@ VOID LocoPsxInit (PLOCOPSX_CONFIG pConfig)
    Nrf24SetPipeRXEnabled(pConfig->nPipe, TRUE);
    Nrf24SetRXAddress(pConfig->nPipe, pConfig->pszAddress);
    Nrf24SetPayloadLength(pConfig->nPipe, PSX_PACKETSIZE);
-   Nrf24SetPipeAutoAck(pConfig->nPipe, FALSE);
+   // acknowledge pads that request it (PSX_ACK_TELEMETRY), so that they
+   // do not retry every message; pads that send without ACKs are unaffected
+   Nrf24SetPipeAutoAck(pConfig->nPipe, TRUE);
 }
 //-----------< FUNCTION: LocoPsxBeginRead >----------------------------------
 // Purpose:    starts an asynchronous chuk read operation
@@ -59,10 +61,11 @@ VOID LocoPsxBeginRead ()
 PLOCOPSX_INPUT LocoPsxEndRead (PLOCOPSX_INPUT pInput)
 {
    // attempt to receive a chuk packet from the NRF24
-   if (Nrf24ClearIrq(NRF24_IRQ_ALL) & NRF24_IRQ_RX_DR)
+   // . the STATUS byte clocked out with the read reports whether a packet
+   //   was available, so no separate status poll is needed
+   BYTE pbPkt[PSX_PACKETSIZE];
+   if (Nrf24Recv(pbPkt, PSX_PACKETSIZE) != NULL)
    {
-      BYTE pbPkt[PSX_PACKETSIZE];
-      Nrf24Recv(pbPkt, PSX_PACKETSIZE);
       // decode the readings from the buffer
       BOOL lb2 = !((pbPkt[1] >> 0) & 0x1);   // byte 1[0] is !left 2 button
       BOOL rb2 = !((pbPkt[1] >> 1) & 0x1);   // byte 1[1] is !right 2 button
@@ -22,16 +22,38 @@
 //-------------------[      Library Include Files      ]-------------------//
 //-------------------[      Project Include Files      ]-------------------//
 #include "nrfping.h"
+#include "uart.h"
 #include "spimast.h"
 #include "nrf24.h"
 //-------------------[       Module Definitions        ]-------------------//
 // AVR pin configuration   
 #define PIN_NRF24_SS          PIN_SS
 #define PIN_NRF24_CE          PIN_B1
+// benchmark configuration
+// . each data rate is measured by keeping the send queue full for one 
+//   second, timed with timer 1 at F_CPU/1024
+#define PING_QUEUE_DEPTH      (NRF24_TX_FIFO_DEPTH + 1)
+#define PING_TICKS_PER_SEC    (F_CPU / 1024)
 //-------------------[        Module Variables         ]-------------------//
+static BYTE          g_pbPayload[NRF24_PACKET_MAX] = { 0x60, 0x0D, 0xF0, 0x0D };
+static NRF24_PACKET  g_pPackets[PING_QUEUE_DEPTH];
+static volatile BOOL g_fRunning = FALSE;
+static volatile UI16 g_nSent    = 0;
+static volatile UI16 g_nFailed  = 0;
+static const struct
+{
+   UI8   fRate;
+   PCSTR pszName;
+} g_pRates[] =
+{
+   { NRF24_RATE_250KBPS, "250kbps" },
+   { NRF24_RATE_1MBPS,   "1mbps" },
+   { NRF24_RATE_2MBPS,   "2mbps" }
+};
 //-------------------[        Module Prototypes        ]-------------------//
-static VOID PingInit ();
-static VOID PingRun  ();
+static VOID PingInit   ();
+static VOID PingRun    ();
+static VOID PingOnSent (PNRF24_PACKET pPacket);
 //-------------------[         Implementation          ]-------------------//
 //-----------< FUNCTION: main >----------------------------------------------
 // Purpose:    program entry point
@@ -55,6 +77,7 @@ VOID PingInit ()
 {
    // protocol initialization
    sei();
+   UartInit(&(UART_CONFIG) { 0, });
    SpiInit();
    // hardware initialization
    Nrf24Init(
@@ -68,16 +91,71 @@ VOID PingInit ()
    Nrf24DisableAck();
    Nrf24SetTXAddress("Nrf00");
    Nrf24SetPipeAutoAck(NRF24_PIPE0, FALSE);
-   Nrf24PowerOn(NRF24_MODE_SEND);
+   // benchmark initialization
+   for (UI8 i = 0; i < PING_QUEUE_DEPTH; i++)
+   {
+      g_pPackets[i].pvData        = g_pbPayload;
+      g_pPackets[i].cbData        = sizeof(g_pbPayload);
+      g_pPackets[i].pfnOnComplete = PingOnSent;
+   }
+   TCCR1A = 0;
+   TCCR1B = AvrClk1Scale(1024);
 }
 //-----------< FUNCTION: PingRun >--------------------------------------------
 // Purpose:    ping main loop
+//             measures the send throughput at each data rate, and reports
+//             it over UART
 // Parameters: none
 // Returns:    none
 //---------------------------------------------------------------------------
 VOID PingRun ()
 {
-   BYTE pbMessage[] = { 0x60, 0x0D, 0xF0, 0x0D };
-   Nrf24Send(pbMessage, sizeof(pbMessage));
-   _delay_ms(20);
+   for (UI8 i = 0; i < sizeof(g_pRates) / sizeof(*g_pRates); i++)
+   {
+      Nrf24PowerOff();
+      Nrf24SetRFDataRate(g_pRates[i].fRate);
+      Nrf24PowerOn(NRF24_MODE_SEND);
+      // fill the send queue, which the completion callback keeps full
+      g_nSent    = 0;
+      g_nFailed  = 0;
+      g_fRunning = TRUE;
+      TCNT1      = 0;
+      for (UI8 j = 0; j < PING_QUEUE_DEPTH; j++)
+         Nrf24QueueSend(&g_pPackets[j]);
+      while (TCNT1 < PING_TICKS_PER_SEC)
+         Nrf24Poll();
+      // stop refilling the queue, and let it drain
+      UI16 nSent   = 0;
+      UI16 nFailed = 0;
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+      {
+         g_fRunning = FALSE;
+         nSent      = g_nSent;
+         nFailed    = g_nFailed;
+      }
+      while (Nrf24IsSendQueueBusy())
+         Nrf24Poll();
+      UartSendLine(
+         "%s: %u packets/s, %lu bytes/s, %u failed",
+         g_pRates[i].pszName,
+         nSent,
+         (UI32)nSent * sizeof(g_pbPayload),
+         nFailed
+      );
+   }
+}
+//-----------< FUNCTION: PingOnSent >-----------------------------------------
+// Purpose:    send queue completion callback
+//             counts the packet and queues it again while running
+// Parameters: pPacket - the completed packet
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID PingOnSent (PNRF24_PACKET pPacket)
+{
+   if (pPacket->nStatus == NRF24_SEND_OK)
+      g_nSent++;
+   else
+      g_nFailed++;
+   if (g_fRunning)
+      Nrf24QueueSend(pPacket);
 }
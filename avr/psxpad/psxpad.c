@@ -31,19 +31,30 @@
 #define PSX_PIN_LED           PIN_D7            // LED heartbeat pin
 #define PSX_PAD_PIN_SS        PIN_SS            // PSX pad slave select pin
 #define PSX_MESSAGE_LENGTH    6                 // controller state buffer length
-#define PSX_CLOCK_PERIOD_2    16                // PSX pad SPI clock period / 2, in us
+#define PSX_PAD_FREQUENCY     250000            // PSX pad SPI clock, in Hz
+#define PSX_PAD_ATT_DELAY     16                // PSX pad ATT setup/hold, in us
 #define PSX_NRF24_PIN_SS      PIN_B1            // NRF24 slave select pin
 #define PSX_NRF24_PIN_CE      PIN_B0            // NRF24 CE pin
+#define PSX_HEARTBEAT_COUNT   1000              // packets per LED toggle
+// . PSX_ACK_TELEMETRY requests an ACK for each message, and accepts
+//   telemetry returned by the receiver as the ACK payload
+#ifndef PSX_ACK_TELEMETRY
+#  define PSX_ACK_TELEMETRY   0
+#endif
 //-------------------[        Module Variables         ]-------------------//
 // NRF address SRAM/EEPROM
 static CHAR       g_szAddress[PSX_ADDRESS_LENGTH];
 static CHAR EEMEM g_szEEAddress[PSX_ADDRESS_LENGTH] = PSX_ADDRESS_DEFAULT;
 // PSX message buffer
 static BYTE       g_pbMessage[PSX_MESSAGE_LENGTH];
+// PSX pad SPI settings (LSB first, CPOL, CPHA, ATT setup/hold delay)
+static const SPI_DEVICE g_PsxDevice =
+   SPI_DEVICE_INIT_DELAY(PSX_PAD_FREQUENCY, TRUE, 1, 1, PSX_PAD_ATT_DELAY);
 //-------------------[        Module Prototypes        ]-------------------//
 static VOID       PsxInit           ();
 static BOOL       PsxRead           ();
 static VOID       PsxSend           ();
+static VOID       PsxHeartbeat      ();
 static PBYTE      PsxSpiExchange    (PBYTE pbMessage, UI8 cbMessage);
 //-------------------[         Implementation          ]-------------------//
 //-----------< FUNCTION: main >----------------------------------------------
@@ -78,7 +89,9 @@ VOID PsxInit ()
    //   - chip enable on B1
    //   - 16-bit CRC
    //   - transceiver address ffrom EEPROM
-   //   - transmit mode with no acknowledgements
+   //   - transmit mode with no acknowledgements, or else with ACK
+   //     payloads received on pipe 0 at the transceiver address, and a
+   //     500us retry delay to cover telemetry payloads over 15 bytes
    SpiInit();
    Nrf24Init(
       &(NRF24_CONFIG)
@@ -89,12 +102,22 @@ VOID PsxInit ()
    );
    Nrf24SetCrc(NRF24_CRC_16BIT);
    Nrf24SetTXAddress(g_szAddress);
+#if PSX_ACK_TELEMETRY
+   Nrf24SetRXAddress(NRF24_PIPE0, g_szAddress);
+   Nrf24SetFeatures(NRF24_FEATURE_DYNPAYLOAD | NRF24_FEATURE_ACKPAYLOAD);
+   Nrf24SetPipeDynPayload(NRF24_PIPE0, TRUE);
+   Nrf24SetPipeAutoAck(NRF24_PIPE0, TRUE);
+   Nrf24SetRetryDelay(500);
+#else
    Nrf24DisableAck();
    Nrf24SetPipeAutoAck(NRF24_PIPE0, FALSE);
+#endif
    Nrf24PowerOn(NRF24_MODE_SEND);
    // initialize PSX pins
+   // . the pad data line is open collector, so pull up MISO
    PinSetHi(PSX_PAD_PIN_SS);
    PinSetOutput(PSX_PAD_PIN_SS);
+   PinSetPullUp(PIN_MISO);
    // enter PSX pad config mode
    PsxSpiExchange((BYTE[]) { 0x01, 0x43, 0x00, 0x01 }, 4);
    // switch the pad to analog mode
@@ -134,9 +157,37 @@ VOID PsxSend ()
 {
    // send the PSX message
    Nrf24Send(g_pbMessage, PSX_MESSAGE_LENGTH);
-   // toggle the heartbeat LED
+#if PSX_ACK_TELEMETRY
+   // wait for the message to be acknowledged or to exhaust its retries
+   UI8 fIrq;
+   while (!((fIrq = Nrf24GetIrq()) & (NRF24_IRQ_TX_DS | NRF24_IRQ_MAX_RT)))
+      ;
+   Nrf24ClearIrq(fIrq);
+   if (fIrq & NRF24_IRQ_MAX_RT)
+   {
+      // the failed message blocks the TX FIFO, so discard it
+      Nrf24FlushSend();
+      return;
+   }
+   // drain the telemetry returned with the ACK, if any, so that the RX
+   // FIFO never fills and blocks further ACKs
+   // . the heartbeat then only runs while the receiver is answering
+   BYTE pbTelemetry[NRF24_PACKET_MAX];
+   while (Nrf24Recv(pbTelemetry, NRF24_PACKET_MAX) != NULL)
+      PsxHeartbeat();
+#else
+   PsxHeartbeat();
+#endif
+}
+//-----------< FUNCTION: PsxHeartbeat >--------------------------------------
+// Purpose:    toggles the heartbeat LED every PSX_HEARTBEAT_COUNT calls
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID PsxHeartbeat ()
+{
    static UI16 g_nCounter = 0;
-   if (g_nCounter++ == 1000)
+   if (g_nCounter++ == PSX_HEARTBEAT_COUNT)
    {
       g_nCounter = 0;
       PinToggle(PSX_PIN_LED);
@@ -150,42 +201,19 @@ VOID PsxSend ()
 //---------------------------------------------------------------------------
 PBYTE PsxSpiExchange (PBYTE pbMessage, UI8 cbMessage)
 {
-   // disable SPI hardware, since we are bit banging on the same pins
-   SpiWait();
-   SPCR &= ~(1 << SPE);
-   // configure SPI pins for bit banging
-   PinSetHi(PIN_SCK);
-   PinSetOutput(PIN_SCK);
-   PinSetLo(PIN_MOSI);
-   PinSetOutput(PIN_MOSI);
-   PinSetPullUp(PIN_MISO);
-   // pull CS low with a half-period delay
-   PinSetLo(PSX_PAD_PIN_SS);
-   _delay_us(PSX_CLOCK_PERIOD_2);
-   // exchange all requested data bytes
-   for (UI8 i = 0; i < cbMessage; i++)
+   // exchange in place on the hardware SPI, which switches to the
+   // pad's settings for this transaction and back for the NRF24
+   // . the device's select delay holds ATT low before the first clock
+   //   and high after the exchange, and keeps it off the polled path
+   BUS_TRANSACTION trans =
    {
-      BYTE bSend = pbMessage[i];
-      BYTE bRecv = 0;
-      // exchange the current data byte, LSB first
-      for (I8 j = 0; j < 8; j++)
-      {
-         // CPOL, so clock is low when active
-         // CPHA, so set the output value when clock is low
-         PinSetLo(PIN_SCK);
-         PinSet(PIN_MOSI, (bSend >> j) & 0x1);
-         _delay_us(PSX_CLOCK_PERIOD_2);
-         // set the clock high and sample the input bit
-         PinSetHi(PIN_SCK);
-         _delay_us(PSX_CLOCK_PERIOD_2);
-         bRecv |= (PinRead(PIN_MISO) << j);
-      }
-      pbMessage[i] = bRecv;
-   }
-   // reset CS to end the transaction
-   PinSetHi(PSX_PAD_PIN_SS);
-   _delay_us(PSX_CLOCK_PERIOD_2);
-   // re-enable the SPI hardware and return the results
-   SPCR |= (1 << SPE);
+      .pvDevice = &g_PsxDevice,
+      .nAddress = PSX_PAD_PIN_SS,
+      .pbSend   = pbMessage,
+      .cbSend   = cbMessage,
+      .pbRecv   = pbMessage,
+      .cbRecv   = cbMessage
+   };
+   SpiExecute(&trans);
    return pbMessage;
 }
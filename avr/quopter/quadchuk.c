@@ -67,10 +67,11 @@ VOID QuadChukBeginRead ()
 PQUADCHUK_INPUT QuadChukEndRead (PQUADCHUK_INPUT pInput)
 {
    // attempt to receive a chuk packet from the NRF24
-   if (Nrf24ClearIrq(NRF24_IRQ_ALL) & NRF24_IRQ_RX_DR)
+   // . the STATUS byte clocked out with the read reports whether a packet
+   //   was available, so no separate status poll is needed
+   BYTE pbPkt[CHUK_PACKETSIZE];
+   if (Nrf24Recv(pbPkt, CHUK_PACKETSIZE) != NULL)
    {
-      BYTE pbPkt[CHUK_PACKETSIZE];
-      Nrf24Recv(pbPkt, CHUK_PACKETSIZE);
       // decode the readings from the buffer
       UI8  ljx = pbPkt[0];                   // byte 0 is left joystick X
       UI8  ljy = pbPkt[1];                   // byte 1 is left joystick Y
@@ -93,13 +93,17 @@ VOID QuadMpuBeginRead ()
 // Purpose:    completes an asynchronous read of the MPU sensors
 //             and filters the results
 // Parameters: pSensor - return the sensor readings via here
-// Returns:    pSensor
+// Returns:    pSensor if successful
+//             NULL if the sensor read failed
 //---------------------------------------------------------------------------
 QUADMPU_SENSOR* QuadMpuEndRead (PQUADMPU_SENSOR pSensor)
 {
    // complete the async sensor read
+   // . on an I2C failure, skip this sample and leave
+   //   the filter state as of the last good reading
    MPU6050_SENSORS mpu;
-   Mpu6050EndReadSensors(&mpu);
+   if (Mpu6050EndReadSensors(&mpu) == NULL)
+      return NULL;
    // scale the sensor readings
    // . accelerometer default raw range is 0g-2g, convert to radians
    // . gyroscope default raw range is 250 deg/sec, convert to radians/sec
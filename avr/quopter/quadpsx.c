@@ -22,6 +22,7 @@
 //-------------------[      Library Include Files      ]-------------------//
 #include <math.h>
 //-------------------[      Project Include Files      ]-------------------//
+#include "quopter.h"
 #include "quadpsx.h"
 #include "nrf24.h"
 //-------------------[       Module Definitions        ]-------------------//
@@ -39,7 +40,17 @@ VOID QuadPsxInit (PQUADPSX_CONFIG pConfig)
    Nrf24SetPipeRXEnabled(pConfig->nPipe, TRUE);
    Nrf24SetRXAddress(pConfig->nPipe, pConfig->pszAddress);
    Nrf24SetPayloadLength(pConfig->nPipe, PSX_PACKETSIZE);
+#if QUOPTER_ACK_TELEMETRY
+   // acknowledge control packets, so that telemetry can ride on the acks
+   // . ACK payloads require dynamic payloads on the pipe
+   Nrf24SetFeatures(
+      Nrf24GetFeatures() | NRF24_FEATURE_DYNPAYLOAD | NRF24_FEATURE_ACKPAYLOAD
+   );
+   Nrf24SetPipeDynPayload(pConfig->nPipe, TRUE);
+   Nrf24SetPipeAutoAck(pConfig->nPipe, TRUE);
+#else
    Nrf24SetPipeAutoAck(pConfig->nPipe, FALSE);
+#endif
 }
 //-----------< FUNCTION: QuadPsxBeginRead >----------------------------------
 // Purpose:    starts an asynchronous chuk read operation
@@ -59,10 +70,11 @@ VOID QuadPsxBeginRead ()
 PQUADPSX_INPUT QuadPsxEndRead (PQUADPSX_INPUT pInput)
 {
    // attempt to receive a chuk packet from the NRF24
-   if (Nrf24ClearIrq(NRF24_IRQ_ALL) & NRF24_IRQ_RX_DR)
+   // . the STATUS byte clocked out with the read reports whether a packet
+   //   was available, so no separate status poll is needed
+   BYTE pbPkt[PSX_PACKETSIZE];
+   if (Nrf24Recv(pbPkt, PSX_PACKETSIZE) != NULL)
    {
-      BYTE pbPkt[PSX_PACKETSIZE];
-      Nrf24Recv(pbPkt, PSX_PACKETSIZE);
       // decode the readings from the buffer
       BOOL bsl = !(pbPkt[0] & 0x01);         // byte 0[0] is !select button
       BOOL bst = !(pbPkt[0] & 0x08);         // byte 0[3] is !start button
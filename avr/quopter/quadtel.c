@@ -21,10 +21,14 @@
 //-------------------[       Pre Include Defines       ]-------------------//
 //-------------------[      Library Include Files      ]-------------------//
 //-------------------[      Project Include Files      ]-------------------//
+#include "quopter.h"
 #include "quadtel.h"
 #include "nrf24.h"
 //-------------------[       Module Definitions        ]-------------------//
 //-------------------[        Module Variables         ]-------------------//
+#if QUOPTER_ACK_TELEMETRY
+static UI8 g_nPipe = NRF24_PIPE0;
+#endif
 //-------------------[        Module Prototypes        ]-------------------//
 //-------------------[         Implementation          ]-------------------//
 //-----------< FUNCTION: QuadTelInit >---------------------------------------
@@ -34,9 +38,13 @@
 //---------------------------------------------------------------------------
 VOID QuadTelInit (PQUADTEL_CONFIG pConfig)
 {
+#if QUOPTER_ACK_TELEMETRY
+   g_nPipe = pConfig->nPipe;
+#else
    Nrf24DisableAck();
    Nrf24SetTXAddress(pConfig->pszAddress);
    Nrf24SetPipeAutoAck(NRF24_PIPE0, FALSE);
+#endif
 }
 //-----------< FUNCTION: QuadTelSend >---------------------------------------
 // Purpose:    transmits a telemetrics packet
@@ -45,6 +53,14 @@ VOID QuadTelInit (PQUADTEL_CONFIG pConfig)
 //---------------------------------------------------------------------------
 VOID QuadTelSend (PQUADTEL_DATA pData)
 {
+#if QUOPTER_ACK_TELEMETRY
+   // the previous payload has been sent once the TX FIFO drains, so
+   // load the current telemetry for the next control packet's ACK
+   // . this avoids queueing stale telemetry behind the FIFO
+   if (Nrf24GetFifoStatus() & NRF24_FIFO_TX_EMPTY)
+      Nrf24SetAckPayload(g_nPipe, pData, sizeof(*pData));
+#else
    Nrf24PowerOn(NRF24_MODE_SEND);
    Nrf24Send(pData, sizeof(*pData));
+#endif
 }
@@ -34,6 +34,7 @@
 typedef struct tagQuadTelConfig
 {
    PCSTR pszAddress;                // Quopter NRF24 transmit address
+   UI8   nPipe;                     // PSX receive pipe, for ACK telemetry
 } QUADTEL_CONFIG, *PQUADTEL_CONFIG;
 // input control structure
 typedef struct tagQuadTelData
@@ -118,7 +118,8 @@ void QuopterInit ()
    QuadTelInit(
       &(QUADTEL_CONFIG)
       {
-         .pszAddress = "Qop01"
+         .pszAddress = "Qop01",
+         .nPipe      = 1
       }
    );
    g_Control.nThrustInput = 0.0f;
@@ -139,12 +140,15 @@ void QuopterRun  ()
    QuadRotorControl(&g_Control);
    QuadBayControl(g_bBayOpen);
    // retrieve the sensor readings
+   // . a failed read holds the previous readings for this cycle
    QUADMPU_SENSOR mpu;
-   QuadMpuEndRead(&mpu);
-   mpu.nRollAngle += QUOPTER_ROLL_BIAS;
-   g_Control.nRollSensor  = mpu.nRollAngle;
-   g_Control.nPitchSensor = mpu.nPitchAngle;
-   g_Control.nYawSensor   = mpu.nYawRate;
+   if (QuadMpuEndRead(&mpu) != NULL)
+   {
+      mpu.nRollAngle += QUOPTER_ROLL_BIAS;
+      g_Control.nRollSensor  = mpu.nRollAngle;
+      g_Control.nPitchSensor = mpu.nPitchAngle;
+      g_Control.nYawSensor   = mpu.nYawRate;
+   }
    // retrieve the input readings
    QUADPSX_INPUT psx;
    if (QuadPsxEndRead(&psx) == NULL)
@@ -163,13 +167,15 @@ void QuopterRun  ()
       if (g_nCounter == 0)
          PinToggle(PIN_D4);
    }
-   // broadcast telemetrics
+   // report telemetrics
+   // . sensor values come from the controls, which hold the last good
+   //   reading when the current one failed
    QuadTelSend(
       &(QUADTEL_DATA)
       {
-         .nRollAngle      = mpu.nRollAngle / M_PI * 180,
-         .nPitchAngle     = mpu.nPitchAngle / M_PI * 180,
-         .nYawRate        = mpu.nYawRate * 250,
+         .nRollAngle      = g_Control.nRollSensor / M_PI * 180,
+         .nPitchAngle     = g_Control.nPitchSensor / M_PI * 180,
+         .nYawRate        = g_Control.nYawSensor * 250,
          .nThrustInput    = g_Control.nThrustInput * 100,
          .nRollInput      = g_Control.nRollInput / M_PI * 180,
          .nPitchInput     = g_Control.nPitchInput / M_PI * 180,
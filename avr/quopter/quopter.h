@@ -28,4 +28,15 @@
 #include "avrdefs.h"
 #endif
 //-------------------[       Module Definitions        ]-------------------//
+//===========================================================================
+// QUOPTER CONFIGURATION
+// . QUOPTER_ACK_TELEMETRY    nonzero to return telemetry as the ACK payload
+//                            of each PSX control packet, so the NRF24 stays
+//                            in receive mode (the PsxPad must be built with
+//                            PSX_ACK_TELEMETRY), or zero to broadcast it
+//                            from send mode every loop
+//===========================================================================
+#ifndef QUOPTER_ACK_TELEMETRY
+#  define QUOPTER_ACK_TELEMETRY  (0)
+#endif
 #endif // __QUOPTER_H
@@ -25,8 +25,14 @@
 #include "uart.h"
 //-------------------[       Module Definitions        ]-------------------//
 //-------------------[        Module Variables         ]-------------------//
+// frame awaiting echo from the main loop
+static BYTE          g_pbFrame[UART_FRAME_SIZE + 1];
+static volatile UI8  g_cbFrame = 0;
+static volatile BOOL g_fFrame  = FALSE;
 //-------------------[        Module Prototypes        ]-------------------//
 static VOID OnUartRecv (BYTE b);
+static VOID OnUartFrame (PCBYTE pbFrame, UI8 cbFrame);
+static VOID OnUartBurst (PCBYTE pbData, UI8 cbData);
 //-------------------[         Implementation          ]-------------------//
 //-----------< FUNCTION: main >----------------------------------------------
 // Purpose:    program entry point
@@ -44,28 +50,70 @@ int main ()
    UartInit(
       &(UART_CONFIG)
       {
-         .pfnOnSend = NULL,
-         .pfnOnRecv = OnUartRecv
+         .pfnOnSend      = NULL,
+         .pfnOnRecv      = OnUartRecv,
+         .pfnOnFrame     = OnUartFrame,
+         .pfnOnRecvBurst = OnUartBurst
       }
    );
 
-   for ( ; ; )
+   for (UI16 nTick = 0; ; nTick++)
    {
-      PinToggle(PIN_ARDUINO_LED);
-      _delay_ms(500);
-      PinToggle(PIN_ARDUINO_LED);
-      _delay_ms(1000);
+      // echo a received frame outside the receive interrupt, where the
+      // blocking send can wait for the transmitter to drain the ring
+      if (g_fFrame)
+      {
+         UartSendFrame(g_pbFrame, g_cbFrame);
+         g_fFrame = FALSE;
+      }
+      // blink on for 500ms, off for 1000ms
+      if (nTick == 500)
+         PinToggle(PIN_ARDUINO_LED);
+      else if (nTick == 1500)
+      {
+         PinToggle(PIN_ARDUINO_LED);
+         nTick = 0;
+      }
+      _delay_ms(1);
    }
 
    return 0;
 }
-//-----------< FUNCTION: main >----------------------------------------------
-// Purpose:    program entry point
-// Parameters: none
-// Returns:    0 if successful
-//             nonzero otherwise
+//-----------< FUNCTION: OnUartRecv >----------------------------------------
+// Purpose:    echoes a received byte
+// Parameters: b - the received byte
+// Returns:    none
 //---------------------------------------------------------------------------
 VOID OnUartRecv (BYTE b)
 {
    UartSendByte(b);
 }
+//-----------< FUNCTION: OnUartFrame >---------------------------------------
+// Purpose:    queues a received frame for echo (UART_FRAME builds)
+//             . called from the receive interrupt, where a blocking send
+//               would deadlock once the send ring fills, so the frame is
+//               copied out and echoed from the main loop
+//             . a frame received before the previous echo is dropped
+// Parameters: pbFrame - the frame payload
+//             cbFrame - the payload length
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID OnUartFrame (PCBYTE pbFrame, UI8 cbFrame)
+{
+   if (!g_fFrame)
+   {
+      g_cbFrame = Min(cbFrame, sizeof(g_pbFrame));
+      memcpy(g_pbFrame, pbFrame, g_cbFrame);
+      g_fFrame = TRUE;
+   }
+}
+//-----------< FUNCTION: OnUartBurst >---------------------------------------
+// Purpose:    echoes a received burst (UART_RECV_IDLE builds)
+// Parameters: pbData - the received bytes
+//             cbData - the number of bytes received
+// Returns:    none
+//---------------------------------------------------------------------------
+VOID OnUartBurst (PCBYTE pbData, UI8 cbData)
+{
+   UartTrySend(pbData, cbData);
+}
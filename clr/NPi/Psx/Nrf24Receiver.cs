@@ -10,16 +10,29 @@ namespace NPi.Psx
       private Int32 pipe;
       private Byte[] buffer;
 
-      public Nrf24Receiver (Nrf24 receiver, String address, Int32 pipe = 0)
+      public Nrf24Receiver (Nrf24 receiver, String address, Int32 pipe = 0, Boolean ackPayload = false)
       {
          this.buffer = new Byte[PsxPadState.EncodedSizeAnalog];
          this.pipe = pipe;
          this.receiver = receiver;
          this.receiver.SetRXAddress(pipe, address);
          this.receiver.SetRXLength(pipe, PsxPadState.EncodedSizeAnalog);
+         // acknowledge pads that request it, optionally returning the
+         // ack payload with each acknowledgement
          var ack = new Nrf24.PipeFlagRegister(this.receiver.AutoAck);
-         ack[pipe] = false;
+         ack[pipe] = true;
          this.receiver.AutoAck = ack;
+         if (ackPayload)
+         {
+            this.receiver.Features = new Nrf24.FeatureRegister(this.receiver.Features)
+            {
+               DynPayload = true,
+               AckPayload = true
+            };
+            var dyn = new Nrf24.PipeFlagRegister(this.receiver.DynPayload);
+            dyn[pipe] = true;
+            this.receiver.DynPayload = dyn;
+         }
          this.receiver.RXDataReady += status =>
          {
             if (status.RXReadyPipe == this.pipe)
@@ -27,6 +40,11 @@ namespace NPi.Psx
                this.receiver.ReceivePacket(this.buffer);
                if (this.Received != null)
                   this.Received(PsxPadState.Decode(this.buffer, 0, this.buffer.Length));
+               // the previous ack payload has been sent once the TX FIFO
+               // drains, so load the current one for the next packet
+               var payload = this.AckPayload;
+               if (ackPayload && payload != null && this.receiver.FifoStatus.TXEmpty)
+                  this.receiver.WriteAckPayload(this.pipe, payload);
             }
          };
       }
@@ -34,6 +52,8 @@ namespace NPi.Psx
       {
       }
 
+      public Byte[] AckPayload { get; set; }
+
       #region IWiiChukReceiver Implementation
       public event Action<PsxPadState> Received;
       #endregion
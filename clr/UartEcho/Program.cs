@@ -3,6 +3,7 @@ using System.Collections.Generic;
 using System.IO.Ports;
 using System.Linq;
 using System.Threading;
+using NPi;
 
 namespace UartEcho
 {
@@ -13,6 +14,7 @@ namespace UartEcho
       static Parity parityBits;
       static Int32 dataBits;
       static StopBits stopBits;
+      static Boolean frame;
 
       static Int32 Main (String[] options)
       {
@@ -38,6 +40,7 @@ namespace UartEcho
          parityBits = Parity.None;
          dataBits = 8;
          stopBits = StopBits.One;
+         frame = false;
          // parse options
          try
          {
@@ -48,6 +51,7 @@ namespace UartEcho
                { "p|parity=", v => parityBits = (Parity)Enum.Parse(typeof(Parity), v, true) },
                { "d|data=", (Int32 v) => dataBits = v },
                { "s|stop=", v => stopBits = (StopBits)Enum.Parse(typeof(StopBits), v, true) },
+               { "f|frame", v => frame = (v != null) },
                { "?|help", v => { throw new ArgumentException(); } }
             }.Parse(options);
          }
@@ -63,6 +67,7 @@ namespace UartEcho
          Console.WriteLine("      -p|-parity {none|even|odd|mark|space} parity bits, default=none");
          Console.WriteLine("      -d|-data {bits} data bits, default=8");
          Console.WriteLine("      -s|-stop {none|one|onepointfive|two} stop bits, default=one");
+         Console.WriteLine("      -f|-frame decode COBS/CRC-16 frames, default=false");
       }
 
       static void ExecuteEcho ()
@@ -73,14 +78,33 @@ namespace UartEcho
             port.Open();
             port.DiscardInBuffer();
             Console.WriteLine("done. Now listening. Press escape to exit.");
+            var decoder = new UartFrame();
+            var buffer = new Byte[4096];
             for (; ; )
             {
                if (Console.KeyAvailable && Console.ReadKey(true).Key == ConsoleKey.Escape)
                   break;
                if (port.BytesToRead > 0)
-                  Console.Write(port.ReadExisting());
+               {
+                  if (!frame)
+                     Console.Write(port.ReadExisting());
+                  else
+                  {
+                     // decode and dump each complete frame
+                     var read = port.Read(buffer, 0, buffer.Length);
+                     foreach (var packet in decoder.Decode(buffer, 0, read))
+                        Console.WriteLine(
+                           "   {0:h:mm:ss tt}: [{1}] {2}",
+                           DateTime.Now,
+                           packet.Length,
+                           BitConverter.ToString(packet)
+                        );
+                  }
+               }
                Thread.Sleep(1);
             }
+            if (frame)
+               Console.WriteLine("   Frame errors: {0}", decoder.Errors);
          }
       }
    }
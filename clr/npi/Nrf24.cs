@@ -55,6 +55,7 @@ namespace NPi
       private const Byte CommandRegisterWrite = 0x20;
       private const Byte CommandRXReadPacket = 0x61;
       private const Byte CommandTXWritePacket = 0xA0;
+      private const Byte CommandAckWritePacket = 0xA8;
       private const Byte CommandTXFlush = 0xE1;
       private const Byte CommandRXFlush = 0xE2;
       private const Byte CommandTXReuse = 0xE3;
@@ -518,6 +519,18 @@ namespace NPi
          this.cePin.Value = true;
          this.cePin.Value = false;
       }
+      public void WriteAckPayload (Int32 pipe, Byte[] data)
+      {
+         if (pipe < 0 || pipe > 5)
+            throw new ArgumentOutOfRangeException("pipe");
+         if (data.Length > MaxPayload)
+            throw new ArgumentOutOfRangeException("data");
+         if (!this.Features.AckPayload)
+            throw new InvalidOperationException("The ack payload feature is not enabled");
+         this.buffer[0] = (Byte)(CommandAckWritePacket | pipe);
+         Array.Copy(data, 0, this.buffer, 1, data.Length);
+         ReadWrite(data.Length);
+      }
       public void FlushTransmit ()
       {
          this.buffer[0] = CommandTXFlush;
@@ -537,7 +550,8 @@ namespace NPi
       }
       public Byte[] ReceivePacket (Byte[] buffer, Int32 length)
       {
-         if (this.config.Mode != Mode.Receive)
+         // in transmit mode, packets are the payloads of received acks
+         if (this.config.Mode != Mode.Receive && !this.Features.AckPayload)
             throw new InvalidOperationException("The tranceiver is not configured for receive");
          this.buffer[0] = CommandRXReadPacket;
          ReadWrite(length);
@@ -553,6 +567,10 @@ namespace NPi
          var length = GetRXLength(pipe);
          return ReceivePacket(new Byte[length]);
       }
+      public Byte[] ReceiveDynamicPacket ()
+      {
+         return ReceivePacket(new Byte[GetRXDynamicLength()]);
+      }
       public void FlushReceive ()
       {
          this.buffer[0] = CommandRXFlush;
@@ -562,6 +580,9 @@ namespace NPi
       {
          var addrLength = this.AddressWidth;
          var rxEnabled = this.RXEnabled;
+         var features = this.Features;
+         if (features.AckPayload && !features.DynPayload)
+            throw new InvalidOperationException("Dynamic payloads must be enabled if the ack payload feature is set");
          switch (this.config.Mode)
          {
             case Mode.Transmit:
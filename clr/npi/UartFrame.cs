@@ -0,0 +1,114 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace NPi
+{
+   // COBS framing with CRC-16, compatible with the AVR UART frame layer
+   // . the payload is followed by a little-endian CRC-16 (CCITT reflected,
+   //   0xFFFF initial value) and the result is COBS-encoded
+   // . frames are terminated with a zero byte
+   public class UartFrame
+   {
+      public const Byte Delimiter = 0x00;
+      public const Int32 MaxFrame = 253;
+      private Byte[] frame;
+      private Int32 length;
+      private Int32 block;
+      private Boolean blockZero;
+      private Boolean overflow;
+
+      public UartFrame (Int32 maxFrame = MaxFrame)
+      {
+         this.frame = new Byte[maxFrame + 2];
+      }
+
+      public Int32 Errors
+      {
+         get; private set;
+      }
+
+      public static UInt16 Crc16 (UInt16 crc, Byte data)
+      {
+         data ^= (Byte)crc;
+         data ^= (Byte)(data << 4);
+         return (UInt16)(
+            ((data << 8) | (crc >> 8)) ^ 
+            (Byte)(data >> 4) ^ 
+            (data << 3)
+         );
+      }
+
+      public static Byte[] Encode (Byte[] payload)
+      {
+         // append the payload CRC
+         var crc = payload.Aggregate((UInt16)0xFFFF, (c, b) => Crc16(c, b));
+         var data = payload.Concat(new[] { (Byte)crc, (Byte)(crc >> 8) }).ToArray();
+         // encode the COBS blocks
+         var encoded = new List<Byte>(data.Length + data.Length / 254 + 2);
+         var start = 0;
+         for ( ; ; )
+         {
+            var end = start;
+            while (end < data.Length && end - start < 254 && data[end] != 0)
+               end++;
+            encoded.Add((Byte)(end - start + 1));
+            encoded.AddRange(data.Skip(start).Take(end - start));
+            if (end == data.Length)
+               break;
+            start = (end - start < 254) ? end + 1 : end;
+         }
+         encoded.Add(Delimiter);
+         return encoded.ToArray();
+      }
+
+      public IList<Byte[]> Decode (Byte[] buffer, Int32 offset, Int32 count)
+      {
+         var frames = new List<Byte[]>();
+         for (var i = offset; i < offset + count; i++)
+         {
+            var b = buffer[i];
+            if (b == Delimiter)
+            {
+               // end of frame, validate the length and CRC
+               if (this.length > 0)
+               {
+                  var crc = this.frame
+                     .Take(this.length)
+                     .Aggregate((UInt16)0xFFFF, (c, d) => Crc16(c, d));
+                  if (!this.overflow && this.block == 0 && this.length >= 2 && crc == 0)
+                     frames.Add(this.frame.Take(this.length - 2).ToArray());
+                  else
+                     this.Errors++;
+               }
+               this.length = 0;
+               this.block = 0;
+               this.blockZero = false;
+               this.overflow = false;
+            }
+            else if (this.block == 0)
+            {
+               // start of a COBS block, append the previous block's zero
+               if (this.blockZero)
+                  Append(0);
+               this.block = b - 1;
+               this.blockZero = (b != 0xFF);
+            }
+            else
+            {
+               Append(b);
+               this.block--;
+            }
+         }
+         return frames;
+      }
+
+      private void Append (Byte b)
+      {
+         if (this.length < this.frame.Length)
+            this.frame[this.length++] = b;
+         else
+            this.overflow = true;
+      }
+   }
+}
@@ -3,6 +3,7 @@ using System.Collections.Generic;
 using System.IO.Ports;
 using System.Linq;
 using System.Threading;
+using NPi;
 
 namespace UartPing
 {
@@ -14,6 +15,7 @@ namespace UartPing
       static Int32 dataBits;
       static StopBits stopBits;
       static Int32 message;
+      static Boolean frame;
 
       static Int32 Main (String[] options)
       {
@@ -40,6 +42,7 @@ namespace UartPing
          dataBits = 8;
          stopBits = StopBits.One;
          message = 0xC0;
+         frame = false;
          // parse options
          try
          {
@@ -51,6 +54,7 @@ namespace UartPing
                { "d|data=", (Int32 v) => dataBits = v },
                { "s|stop=", v => stopBits = (StopBits)Enum.Parse(typeof(StopBits), v, true) },
                { "m|message=", (Int32 v) => message = v },
+               { "f|frame", v => frame = (v != null) },
                { "?|help", v => { throw new ArgumentException(); } }
             }.Parse(options);
          }
@@ -67,6 +71,7 @@ namespace UartPing
          Console.WriteLine("      -d|-data {bits} data bits, default=8");
          Console.WriteLine("      -s|-stop {none|one|onepointfive|two} stop bits, default=one");
          Console.WriteLine("      -m|-message {msg} ping message, default=0xC0");
+         Console.WriteLine("      -f|-frame send/receive COBS/CRC-16 frames, default=false");
       }
 
       static void ExecutePing ()
@@ -77,15 +82,34 @@ namespace UartPing
             port.Open();
             port.DiscardInBuffer();
             Console.WriteLine("done. Press escape to exit.");
+            var decoder = new UartFrame();
             for (; ; )
             {
                if (Console.KeyAvailable && Console.ReadKey(true).Key == ConsoleKey.Escape)
                   break;
                Console.Write("\r   {0:h:mm:ss tt}: Sending 0x{1}... ", DateTime.Now, message.ToString("X"));
-               port.Write(new[] { (Byte)message }, 0, 1);
-               while (port.BytesToRead == 0)
-                  Thread.Sleep(1);
-               Console.Write("Received: 0x{0}", port.ReadByte().ToString("X"));
+               if (!frame)
+               {
+                  port.Write(new[] { (Byte)message }, 0, 1);
+                  while (port.BytesToRead == 0)
+                     Thread.Sleep(1);
+                  Console.Write("Received: 0x{0}", port.ReadByte().ToString("X"));
+               }
+               else
+               {
+                  var request = UartFrame.Encode(new[] { (Byte)message });
+                  port.Write(request, 0, request.Length);
+                  var response = (Byte[])null;
+                  var buffer = new Byte[256];
+                  while (response == null)
+                  {
+                     while (port.BytesToRead == 0)
+                        Thread.Sleep(1);
+                     var read = port.Read(buffer, 0, buffer.Length);
+                     response = decoder.Decode(buffer, 0, read).FirstOrDefault();
+                  }
+                  Console.Write("Received: {0} ", BitConverter.ToString(response));
+               }
                Thread.Sleep(1000);
             }
             Console.WriteLine();
@@ -0,0 +1,515 @@
+//===========================================================================
+// Module:  tracedump.c
+// Purpose: AVR binary trace log decoder
+//
+// Copyright © 2013
+// Brent M. Spell. All rights reserved.
+//
+// This library is free software; you can redistribute it and/or modify it 
+// under the terms of the GNU Lesser General Public License as published 
+// by the Free Software Foundation; either version 3 of the License, or 
+// (at your option) any later version. This library is distributed in the 
+// hope that it will be useful, but WITHOUT ANY WARRANTY; without even the 
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+// See the GNU Lesser General Public License for more details. You should 
+// have received a copy of the GNU Lesser General Public License along with 
+// this library; if not, write to 
+//    Free Software Foundation, Inc. 
+//    51 Franklin Street, Fifth Floor 
+//    Boston, MA 02110-1301 USA
+//===========================================================================
+//-------------------[       Pre Include Defines       ]-------------------//
+#define _DEFAULT_SOURCE
+//-------------------[      Library Include Files      ]-------------------//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <elf.h>
+//-------------------[      Project Include Files      ]-------------------//
+//-------------------[       Module Definitions        ]-------------------//
+#define TRACE_SECTION      ".trace"       // message table ELF section
+#define TRACE_ID_DROPPED   0xFFFF         // dropped records message ID
+#define AVR_DATA_OFFSET    0x800000       // AVR RAM address in ELF images
+#define FRAME_MAX          256            // maximum encoded frame length
+// loaded ELF section
+typedef struct
+{
+   uint64_t nAddress;                     // virtual address
+   uint64_t cbData;                       // section size
+   uint8_t* pbData;                       // section contents
+} SECTION;
+//-------------------[        Module Variables         ]-------------------//
+static uint8_t*   g_pbImage = NULL;       // ELF file contents
+static size_t     g_cbImage = 0;          // ELF file size
+static int        g_nMachine = 0;         // ELF machine type
+static SECTION    g_Trace;                // message table section
+static SECTION*   g_pSections = NULL;     // allocated sections, for strings
+static int        g_cSections = 0;        // allocated section count
+static unsigned   g_nFrameErrors = 0;     // frames that failed decoding
+//-------------------[        Module Prototypes        ]-------------------//
+static int  LoadElf (const char* pszPath);
+static int  OpenInput (const char* pszPath, int nBaud);
+static void ListMessages ();
+static void DecodeFrame (const uint8_t* pbFrame, int cbFrame);
+static void PrintRecord (const uint8_t* pbRecord, int cbRecord);
+static const char* FindString (uint64_t nAddress);
+static uint16_t Crc16 (uint16_t nCrc, uint8_t b);
+//-------------------[         Implementation          ]-------------------//
+//-----------< FUNCTION: main >----------------------------------------------
+// Purpose:    program entry point
+//             usage: tracedump [-l] [-b baud] <elf> [input]
+//             . -l lists the message table and exits
+//             . -b sets the baud rate when the input is a serial port
+//             . the input defaults to stdin
+// Parameters: argc - argument count
+//             argv - argument list
+// Returns:    0 if successful
+//             nonzero otherwise
+//---------------------------------------------------------------------------
+int main (int argc, char* argv[])
+{
+   int  fList = 0;
+   int  nBaud = 57600;
+   int  nOpt;
+   while ((nOpt = getopt(argc, argv, "lb:")) != -1)
+   {
+      switch (nOpt)
+      {
+         case 'l': fList = 1; break;
+         case 'b': nBaud = atoi(optarg); break;
+         default:
+            fprintf(stderr, "usage: tracedump [-l] [-b baud] <elf> [input]\n");
+            return 1;
+      }
+   }
+   if (optind >= argc)
+   {
+      fprintf(stderr, "usage: tracedump [-l] [-b baud] <elf> [input]\n");
+      return 1;
+   }
+   if (LoadElf(argv[optind]) != 0)
+      return 1;
+   if (fList)
+   {
+      ListMessages();
+      return 0;
+   }
+   int hInput = OpenInput(optind + 1 < argc ? argv[optind + 1] : NULL, nBaud);
+   if (hInput < 0)
+      return 1;
+   // accumulate bytes up to each frame delimiter, and decode the frame
+   uint8_t pbFrame[FRAME_MAX];
+   int     cbFrame = 0;
+   uint8_t pbRead[256];
+   ssize_t cbRead;
+   while ((cbRead = read(hInput, pbRead, sizeof(pbRead))) > 0)
+   {
+      for (ssize_t i = 0; i < cbRead; i++)
+      {
+         if (pbRead[i] == 0)
+         {
+            if (cbFrame > 0)
+               DecodeFrame(pbFrame, cbFrame);
+            cbFrame = 0;
+         }
+         else if (cbFrame < FRAME_MAX)
+            pbFrame[cbFrame++] = pbRead[i];
+         else
+         {
+            g_nFrameErrors++;
+            cbFrame = 0;
+         }
+      }
+      fflush(stdout);
+   }
+   if (g_nFrameErrors != 0)
+      fprintf(stderr, "tracedump: %u invalid frames\n", g_nFrameErrors);
+   return 0;
+}
+//-----------< FUNCTION: LoadElf >-------------------------------------------
+// Purpose:    loads the message table and string sections from an ELF file
+// Parameters: pszPath - the ELF file path
+// Returns:    0 if successful
+//             nonzero otherwise
+//---------------------------------------------------------------------------
+static int LoadElf (const char* pszPath)
+{
+   FILE* pFile = fopen(pszPath, "rb");
+   if (pFile == NULL)
+   {
+      perror(pszPath);
+      return 1;
+   }
+   fseek(pFile, 0, SEEK_END);
+   g_cbImage = ftell(pFile);
+   fseek(pFile, 0, SEEK_SET);
+   g_pbImage = malloc(g_cbImage);
+   if (fread(g_pbImage, 1, g_cbImage, pFile) != g_cbImage)
+   {
+      perror(pszPath);
+      fclose(pFile);
+      return 1;
+   }
+   fclose(pFile);
+   if (g_cbImage < EI_NIDENT || memcmp(g_pbImage, ELFMAG, SELFMAG) != 0)
+   {
+      fprintf(stderr, "%s: not an ELF file\n", pszPath);
+      return 1;
+   }
+   // normalize the section headers of 32-bit (AVR) and 64-bit images
+   int fElf64 = g_pbImage[EI_CLASS] == ELFCLASS64;
+   uint64_t nShOffset, cbShEntry, cSh, nShStr;
+   if (fElf64)
+   {
+      Elf64_Ehdr* pHdr = (Elf64_Ehdr*)g_pbImage;
+      g_nMachine = pHdr->e_machine;
+      nShOffset = pHdr->e_shoff; cbShEntry = pHdr->e_shentsize;
+      cSh = pHdr->e_shnum; nShStr = pHdr->e_shstrndx;
+   }
+   else
+   {
+      Elf32_Ehdr* pHdr = (Elf32_Ehdr*)g_pbImage;
+      g_nMachine = pHdr->e_machine;
+      nShOffset = pHdr->e_shoff; cbShEntry = pHdr->e_shentsize;
+      cSh = pHdr->e_shnum; nShStr = pHdr->e_shstrndx;
+   }
+   if (nShOffset + cSh * cbShEntry > g_cbImage || nShStr >= cSh)
+   {
+      fprintf(stderr, "%s: invalid section headers\n", pszPath);
+      return 1;
+   }
+   SECTION* pSections = calloc(cSh, sizeof(SECTION));
+   uint32_t* pnNames  = calloc(cSh, sizeof(uint32_t));
+   uint64_t* pfFlags  = calloc(cSh, sizeof(uint64_t));
+   uint32_t* pnTypes  = calloc(cSh, sizeof(uint32_t));
+   for (uint64_t i = 0; i < cSh; i++)
+   {
+      uint8_t* pbSh = g_pbImage + nShOffset + i * cbShEntry;
+      uint64_t nOffset;
+      if (fElf64)
+      {
+         Elf64_Shdr* pSh = (Elf64_Shdr*)pbSh;
+         pnNames[i] = pSh->sh_name; pnTypes[i] = pSh->sh_type;
+         pfFlags[i] = pSh->sh_flags; nOffset = pSh->sh_offset;
+         pSections[i].nAddress = pSh->sh_addr;
+         pSections[i].cbData = pSh->sh_size;
+      }
+      else
+      {
+         Elf32_Shdr* pSh = (Elf32_Shdr*)pbSh;
+         pnNames[i] = pSh->sh_name; pnTypes[i] = pSh->sh_type;
+         pfFlags[i] = pSh->sh_flags; nOffset = pSh->sh_offset;
+         pSections[i].nAddress = pSh->sh_addr;
+         pSections[i].cbData = pSh->sh_size;
+      }
+      if (pnTypes[i] == SHT_NOBITS || nOffset + pSections[i].cbData > g_cbImage)
+         pSections[i].cbData = 0;
+      pSections[i].pbData = g_pbImage + nOffset;
+   }
+   // locate the message table, and keep the allocated sections for
+   // resolving string arguments
+   const char* pszNames = (const char*)pSections[nShStr].pbData;
+   g_pSections = calloc(cSh, sizeof(SECTION));
+   for (uint64_t i = 0; i < cSh; i++)
+   {
+      if (pnNames[i] >= pSections[nShStr].cbData)
+         continue;
+      if (strcmp(pszNames + pnNames[i], TRACE_SECTION) == 0)
+         g_Trace = pSections[i];
+      else if ((pfFlags[i] & SHF_ALLOC) && pSections[i].cbData != 0)
+         g_pSections[g_cSections++] = pSections[i];
+   }
+   free(pSections); free(pnNames); free(pfFlags); free(pnTypes);
+   if (g_Trace.cbData == 0)
+   {
+      fprintf(stderr, "%s: no %s section\n", pszPath, TRACE_SECTION);
+      return 1;
+   }
+   return 0;
+}
+//-----------< FUNCTION: OpenInput >-----------------------------------------
+// Purpose:    opens the trace input, configuring serial ports for raw
+//             8N1 input
+// Parameters: pszPath - the input path, or NULL for stdin
+//             nBaud   - the serial port baud rate
+// Returns:    the input file descriptor if successful
+//             -1 otherwise
+//---------------------------------------------------------------------------
+static int OpenInput (const char* pszPath, int nBaud)
+{
+   int hInput = pszPath != NULL ? open(pszPath, O_RDONLY | O_NOCTTY) : 0;
+   if (hInput < 0)
+   {
+      perror(pszPath);
+      return -1;
+   }
+   if (isatty(hInput))
+   {
+      speed_t nSpeed;
+      switch (nBaud)
+      {
+         case 9600:   nSpeed = B9600; break;
+         case 19200:  nSpeed = B19200; break;
+         case 38400:  nSpeed = B38400; break;
+         case 57600:  nSpeed = B57600; break;
+         case 115200: nSpeed = B115200; break;
+         case 230400: nSpeed = B230400; break;
+         default:
+            fprintf(stderr, "tracedump: unsupported baud rate %d\n", nBaud);
+            return -1;
+      }
+      struct termios tio;
+      tcgetattr(hInput, &tio);
+      cfmakeraw(&tio);
+      cfsetispeed(&tio, nSpeed);
+      cfsetospeed(&tio, nSpeed);
+      tio.c_cc[VMIN]  = 1;
+      tio.c_cc[VTIME] = 0;
+      if (tcsetattr(hInput, TCSANOW, &tio) != 0)
+      {
+         perror(pszPath);
+         return -1;
+      }
+   }
+   return hInput;
+}
+//-----------< FUNCTION: ListMessages >--------------------------------------
+// Purpose:    prints the message table, one message per line
+// Parameters: none
+// Returns:    none
+//---------------------------------------------------------------------------
+static void ListMessages ()
+{
+   // each entry is an argument count, the argument sizes,
+   // and the format string
+   uint64_t nId = 0;
+   while (nId < g_Trace.cbData)
+   {
+      const uint8_t* pbEntry = g_Trace.pbData + nId;
+      int cArgs = pbEntry[0];
+      const char* pszFormat = (const char*)pbEntry + 1 + cArgs;
+      if (nId + 1 + cArgs >= g_Trace.cbData)
+         break;
+      printf("%04X  ", (unsigned)nId);
+      for (int i = 0; i < cArgs; i++)
+         printf("%d", pbEntry[1 + i]);
+      printf("%*s  ", 8 - cArgs, "");
+      for (const char* psz = pszFormat; *psz != 0; psz++)
+         if (*psz == '\n')
+            printf("\\n");
+         else
+            putchar(*psz);
+      putchar('\n');
+      nId += 1 + cArgs + strlen(pszFormat) + 1;
+   }
+}
+//-----------< FUNCTION: DecodeFrame >---------------------------------------
+// Purpose:    decodes a COBS frame, validates its CRC and prints the
+//             trace record it contains
+// Parameters: pbFrame - the encoded frame, without its delimiter
+//             cbFrame - the encoded frame length
+// Returns:    none
+//---------------------------------------------------------------------------
+static void DecodeFrame (const uint8_t* pbFrame, int cbFrame)
+{
+   uint8_t pbRecord[FRAME_MAX];
+   int     cbRecord = 0;
+   for (int i = 0; i < cbFrame; )
+   {
+      int cbBlock = pbFrame[i++];
+      for (int j = 1; j < cbBlock; j++)
+      {
+         if (i >= cbFrame)
+         {
+            g_nFrameErrors++;
+            return;
+         }
+         pbRecord[cbRecord++] = pbFrame[i++];
+      }
+      if (cbBlock < 0xFF && i < cbFrame)
+         pbRecord[cbRecord++] = 0;
+   }
+   uint16_t nCrc = 0xFFFF;
+   for (int i = 0; i < cbRecord; i++)
+      nCrc = Crc16(nCrc, pbRecord[i]);
+   if (cbRecord < 2 || nCrc != 0)
+   {
+      g_nFrameErrors++;
+      return;
+   }
+   PrintRecord(pbRecord, cbRecord - 2);
+}
+//-----------< FUNCTION: PrintRecord >---------------------------------------
+// Purpose:    formats and prints a trace record
+// Parameters: pbRecord - the record, starting with its header
+//             cbRecord - the record length
+// Returns:    none
+//---------------------------------------------------------------------------
+static void PrintRecord (const uint8_t* pbRecord, int cbRecord)
+{
+   if (cbRecord < 4)
+   {
+      g_nFrameErrors++;
+      return;
+   }
+   unsigned nId   = pbRecord[0] | (pbRecord[1] << 8);
+   unsigned nTime = pbRecord[2] | (pbRecord[3] << 8);
+   const uint8_t* pbArgs = pbRecord + 4;
+   int cbArgs = cbRecord - 4;
+   printf("%5u  ", nTime);
+   if (nId == TRACE_ID_DROPPED && cbArgs == 2)
+   {
+      printf("<%u trace records dropped>\n", pbArgs[0] | (pbArgs[1] << 8));
+      return;
+   }
+   if (nId >= g_Trace.cbData)
+   {
+      printf("<unknown message %04X>\n", nId);
+      return;
+   }
+   // walk the format string, converting each argument from its
+   // stored size to the host type for the conversion
+   const uint8_t* pbEntry = g_Trace.pbData + nId;
+   int            cArgs = pbEntry[0];
+   const uint8_t* pcbArgs = pbEntry + 1;
+   const char*    psz = (const char*)pbEntry + 1 + cArgs;
+   int            nArg = 0;
+   int            fNewLine = 1;
+   while (*psz != 0)
+   {
+      if (*psz != '%' || psz[1] == '%')
+      {
+         fNewLine = *psz == '\n';
+         putchar(*psz);
+         psz += *psz == '%' ? 2 : 1;
+         continue;
+      }
+      // copy the flags, width and precision, and skip length modifiers
+      char  szSpec[32] = "%";
+      int   cchSpec = 1;
+      for (psz++; *psz != 0 && strchr("-+ #0123456789.", *psz); psz++)
+         if (cchSpec < 20)
+            szSpec[cchSpec++] = *psz;
+      while (*psz != 0 && strchr("hlLqjzt", *psz))
+         psz++;
+      char chConv = *psz;
+      if (chConv == 0)
+         break;
+      psz++;
+      if (nArg >= cArgs || pcbArgs[nArg] > 8 || cbArgs < pcbArgs[nArg])
+      {
+         printf("<missing argument>");
+         break;
+      }
+      // read the little-endian argument value
+      int      cbArg = pcbArgs[nArg++];
+      uint64_t nValue = 0;
+      for (int i = 0; i < cbArg; i++)
+         nValue |= (uint64_t)pbArgs[i] << (8 * i);
+      pbArgs += cbArg;
+      cbArgs -= cbArg;
+      fNewLine = 0;
+      switch (chConv)
+      {
+         case 'd':
+         case 'i':
+         {
+            int64_t nSigned = (int64_t)(nValue << (64 - 8 * cbArg)) >> (64 - 8 * cbArg);
+            strcpy(szSpec + cchSpec, "lld");
+            printf(szSpec, (long long)nSigned);
+            break;
+         }
+         case 'u':
+         case 'x':
+         case 'X':
+         case 'o':
+            szSpec[cchSpec++] = 'l';
+            szSpec[cchSpec++] = 'l';
+            szSpec[cchSpec++] = chConv;
+            printf(szSpec, (unsigned long long)nValue);
+            break;
+         case 'c':
+            szSpec[cchSpec++] = 'c';
+            printf(szSpec, (int)(nValue & 0xFF));
+            break;
+         case 'f':
+         case 'e':
+         case 'E':
+         case 'g':
+         case 'G':
+         {
+            double nReal;
+            if (cbArg == sizeof(float))
+            {
+               float nFloat; uint32_t nBits = (uint32_t)nValue;
+               memcpy(&nFloat, &nBits, sizeof(nFloat));
+               nReal = nFloat;
+            }
+            else
+               memcpy(&nReal, &nValue, sizeof(nReal));
+            szSpec[cchSpec++] = chConv;
+            printf(szSpec, nReal);
+            break;
+         }
+         case 's':
+         case 'S':
+         {
+            // AVR data pointers address RAM, which is offset in the
+            // image, and program memory (%S) pointers address flash
+            uint64_t nAddress = nValue;
+            if (g_nMachine == EM_AVR && chConv == 's')
+               nAddress += AVR_DATA_OFFSET;
+            const char* pszArg = FindString(nAddress);
+            szSpec[cchSpec++] = 's';
+            if (pszArg != NULL)
+               printf(szSpec, pszArg);
+            else
+               printf("<%04llX>", (unsigned long long)nValue);
+            break;
+         }
+         default:
+            printf("<%%%c:%llX>", chConv, (unsigned long long)nValue);
+            break;
+      }
+   }
+   if (!fNewLine)
+      putchar('\n');
+}
+//-----------< FUNCTION: FindString >----------------------------------------
+// Purpose:    locates a constant string in the ELF image
+// Parameters: nAddress - the string's virtual address
+// Returns:    the string if found
+//             NULL otherwise
+//---------------------------------------------------------------------------
+static const char* FindString (uint64_t nAddress)
+{
+   for (int i = 0; i < g_cSections; i++)
+   {
+      SECTION* pSection = &g_pSections[i];
+      if (nAddress >= pSection->nAddress &&
+          nAddress < pSection->nAddress + pSection->cbData)
+      {
+         uint64_t nOffset = nAddress - pSection->nAddress;
+         if (memchr(pSection->pbData + nOffset, 0, pSection->cbData - nOffset))
+            return (const char*)pSection->pbData + nOffset;
+      }
+   }
+   return NULL;
+}
+//-----------< FUNCTION: Crc16 >---------------------------------------------
+// Purpose:    updates a CRC-16 (CCITT reflected), matching the AVR
+//             _crc_ccitt_update function
+// Parameters: nCrc - the current CRC
+//             b    - the next data byte
+// Returns:    the updated CRC
+//---------------------------------------------------------------------------
+static uint16_t Crc16 (uint16_t nCrc, uint8_t b)
+{
+   b ^= nCrc & 0xFF;
+   b ^= b << 4;
+   return ((((uint16_t)b << 8) | (nCrc >> 8)) ^ (uint8_t)(b >> 4) ^ ((uint16_t)b << 3));
+}